@@ -0,0 +1,911 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "host.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <chrono>
+#include <atomic>
+
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+#if defined(__GLIBC__) || defined(__APPLE__)
+    #include <execinfo.h>
+    #define HOST_GUARD_BACKTRACE 1
+#else
+    #define HOST_GUARD_BACKTRACE 0
+#endif
+
+extern "C" {
+    FMOD_DSP_DESCRIPTION* F_CALL FMODGetDSPDescription();
+}
+
+/*
+    FMOD_DSP_STATE_FUNCTIONS implementation. The instance pointer of the fabricated state points back at the host.
+*/
+static Host_Instance *Host_FromState(FMOD_DSP_STATE *dsp_state)
+{
+    return (Host_Instance *)dsp_state->instance;
+}
+
+static void * F_CALL Host_Alloc(unsigned int size, FMOD_MEMORY_TYPE, const char *)
+{
+    return malloc(size);
+}
+
+static void * F_CALL Host_Realloc(void *ptr, unsigned int size, FMOD_MEMORY_TYPE, const char *)
+{
+    return realloc(ptr, size);
+}
+
+static void F_CALL Host_Free(void *ptr, FMOD_MEMORY_TYPE, const char *)
+{
+    free(ptr);
+}
+
+static FMOD_RESULT F_CALL Host_GetSampleRate(FMOD_DSP_STATE *dsp_state, int *rate)
+{
+    *rate = Host_FromState(dsp_state)->samplerate;
+    return FMOD_OK;
+}
+
+static FMOD_RESULT F_CALL Host_GetBlockSize(FMOD_DSP_STATE *dsp_state, unsigned int *blocksize)
+{
+    *blocksize = Host_FromState(dsp_state)->blocksize;
+    return FMOD_OK;
+}
+
+static FMOD_RESULT F_CALL Host_GetSpeakerMode(FMOD_DSP_STATE *dsp_state, FMOD_SPEAKERMODE *speakermode_mixer, FMOD_SPEAKERMODE *speakermode_output)
+{
+    Host_Instance *host = Host_FromState(dsp_state);
+    if (speakermode_mixer)
+        *speakermode_mixer = host->speakermode;
+    if (speakermode_output)
+        *speakermode_output = host->speakermode;
+    return FMOD_OK;
+}
+
+static FMOD_RESULT F_CALL Host_GetClock(FMOD_DSP_STATE *dsp_state, unsigned long long *clock, unsigned int *offset, unsigned int *length)
+{
+    Host_Instance *host = Host_FromState(dsp_state);
+    if (clock)
+        *clock = host->clock;
+    if (offset)
+        *offset = 0;
+    if (length)
+        *length = host->blocksize;
+    return FMOD_OK;
+}
+
+static FMOD_RESULT F_CALL Host_GetListenerAttributes(FMOD_DSP_STATE *, int *numlisteners, FMOD_3D_ATTRIBUTES *)
+{
+    *numlisteners = 0;
+    return FMOD_OK;
+}
+
+static void F_CALL Host_Log(FMOD_DEBUG_FLAGS, const char *file, int line, const char *function, const char *string, ...)
+{
+    va_list args;
+    va_start(args, string);
+    fprintf(stderr, "%s(%d) %s: ", file, line, function);
+    vfprintf(stderr, string, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+}
+
+static FMOD_RESULT F_CALL Host_GetUserData(FMOD_DSP_STATE *, void **userdata)
+{
+    *userdata = 0;
+    return FMOD_OK;
+}
+
+/*
+    FMOD numbers its systems from 0 to HOST_MAX_SYSTEMS - 1. Hosts beyond that share the index HOST_MAX_SYSTEMS, which
+    plugins are free to treat as unknown.
+*/
+static std::atomic<unsigned int> gSystems(0);
+
+static int Host_AcquireSystem()
+{
+    unsigned int used = gSystems.load();
+    for (int system = 0; system < HOST_MAX_SYSTEMS; system++)
+    {
+        if (used & (1u << system))
+            continue;
+        if (gSystems.compare_exchange_strong(used, used | (1u << system)))
+            return system;
+        system = -1;
+    }
+    return HOST_MAX_SYSTEMS;
+}
+
+static void Host_ReleaseSystem(int system)
+{
+    if (system < HOST_MAX_SYSTEMS)
+        gSystems.fetch_and(~(1u << system));
+}
+
+FMOD_SPEAKERMODE Host_SpeakerMode(int channels)
+{
+    switch (channels)
+    {
+        case 1:     return FMOD_SPEAKERMODE_MONO;
+        case 2:     return FMOD_SPEAKERMODE_STEREO;
+        case 4:     return FMOD_SPEAKERMODE_QUAD;
+        case 5:     return FMOD_SPEAKERMODE_SURROUND;
+        case 6:     return FMOD_SPEAKERMODE_5POINT1;
+        case 8:     return FMOD_SPEAKERMODE_7POINT1;
+        case 12:    return FMOD_SPEAKERMODE_7POINT1POINT4;
+        default:    return FMOD_SPEAKERMODE_RAW;
+    }
+}
+
+/*
+    FMOD fetches the description once when the plugin is loaded, hosts created from several threads must not run
+    FMODGetDSPDescription (which fills in the parameter descriptions) side by side either.
+*/
+static FMOD_DSP_DESCRIPTION *Host_Description()
+{
+    static FMOD_DSP_DESCRIPTION *desc = FMODGetDSPDescription();
+    return desc;
+}
+
+// systemobject below 0 acquires a system of its own
+static FMOD_RESULT Host_CreateUnit(Host_Instance *host, unsigned int blocksize, int samplerate, int channels, FMOD_SPEAKERMODE speakermode, int systemobject)
+{
+    memset(host, 0, sizeof(Host_Instance));
+
+    host->desc = Host_Description();
+    host->blocksize = blocksize;
+    host->samplerate = samplerate;
+    host->channels = channels;
+    host->speakermode = speakermode;
+
+    host->functions.alloc = Host_Alloc;
+    host->functions.realloc = Host_Realloc;
+    host->functions.free = Host_Free;
+    host->functions.getsamplerate = Host_GetSampleRate;
+    host->functions.getblocksize = Host_GetBlockSize;
+    host->functions.getspeakermode = Host_GetSpeakerMode;
+    host->functions.getclock = Host_GetClock;
+    host->functions.getlistenerattributes = Host_GetListenerAttributes;
+    host->functions.log = Host_Log;
+    host->functions.getuserdata = Host_GetUserData;
+
+    host->state.instance = host;
+    host->state.functions = &host->functions;
+    host->state.source_speakermode = Host_SpeakerMode(channels);
+    host->state.channelmask = 0;
+    host->owns_system = systemobject < 0;
+    host->state.systemobject = host->owns_system ? Host_AcquireSystem() : systemobject;
+
+    host->scratch_in = (float *)calloc(blocksize * channels, sizeof(float));
+    host->scratch_out = (float *)calloc(blocksize * channels, sizeof(float));
+    if (!host->scratch_in || !host->scratch_out)
+    {
+        free(host->scratch_in);
+        free(host->scratch_out);
+        return FMOD_ERR_MEMORY;
+    }
+
+    // The plugin is registered with a system before its first unit is created and deregistered after the last release
+    if (host->owns_system && host->desc->sys_register)
+        host->registered = host->desc->sys_register(&host->state) == FMOD_OK;
+
+    FMOD_RESULT result = host->desc->create(&host->state);
+    if (result != FMOD_OK)
+    {
+        Host_Release(host);
+        return result;
+    }
+
+    // The mixer pushes every parameter default before the first read
+    for (int index = 0; index < host->desc->numparameters; index++)
+    {
+        FMOD_DSP_PARAMETER_DESC *param = host->desc->paramdesc[index];
+        if (param->type == FMOD_DSP_PARAMETER_TYPE_FLOAT)
+            result = Host_SetParameterFloat(host, index, param->floatdesc.defaultval);
+        else if (param->type == FMOD_DSP_PARAMETER_TYPE_INT)
+            result = Host_SetParameterInt(host, index, param->intdesc.defaultval);
+        else if (param->type == FMOD_DSP_PARAMETER_TYPE_BOOL)
+            result = Host_SetParameterBool(host, index, param->booldesc.defaultval != 0);
+        if (result != FMOD_OK)
+            return result;
+    }
+
+    return FMOD_OK;
+}
+
+FMOD_RESULT Host_Create(Host_Instance *host, unsigned int blocksize, int samplerate, int channels)
+{
+    return Host_CreateUnit(host, blocksize, samplerate, channels, Host_SpeakerMode(channels), -1);
+}
+
+FMOD_RESULT Host_CreateInSystem(Host_Instance *host, const Host_Instance *system, int channels)
+{
+    return Host_CreateUnit(host, system->blocksize, system->samplerate, channels, system->speakermode, system->state.systemobject);
+}
+
+FMOD_RESULT Host_Release(Host_Instance *host)
+{
+    FMOD_RESULT result = FMOD_OK;
+
+    if (host->desc && host->desc->release)
+        result = host->desc->release(&host->state);
+    host->state.plugindata = 0;
+
+    if (host->registered)
+        host->desc->sys_deregister(&host->state);
+    host->registered = false;
+
+    free(host->scratch_in);
+    free(host->scratch_out);
+    host->scratch_in = 0;
+    host->scratch_out = 0;
+
+    if (host->desc && host->owns_system)
+        Host_ReleaseSystem(host->state.systemobject);
+    host->desc = 0;
+
+    return result;
+}
+
+FMOD_RESULT Host_Reset(Host_Instance *host)
+{
+    host->clock = 0;
+    return host->desc->reset ? host->desc->reset(&host->state) : FMOD_OK;
+}
+
+FMOD_RESULT Host_SetParameterFloat(Host_Instance *host, int index, float value)
+{
+    if (!host->desc->setparameterfloat)
+        return FMOD_ERR_INVALID_PARAM;
+    return host->desc->setparameterfloat(&host->state, index, value);
+}
+
+FMOD_RESULT Host_SetParameterInt(Host_Instance *host, int index, int value)
+{
+    if (!host->desc->setparameterint)
+        return FMOD_ERR_INVALID_PARAM;
+    return host->desc->setparameterint(&host->state, index, value);
+}
+
+FMOD_RESULT Host_SetParameterBool(Host_Instance *host, int index, bool value)
+{
+    if (!host->desc->setparameterbool)
+        return FMOD_ERR_INVALID_PARAM;
+    return host->desc->setparameterbool(&host->state, index, value ? 1 : 0);
+}
+
+FMOD_RESULT Host_SetParameter(Host_Instance *host, int index, float value)
+{
+    if (index < 0 || index >= host->desc->numparameters)
+        return FMOD_ERR_INVALID_PARAM;
+
+    switch (host->desc->paramdesc[index]->type)
+    {
+        case FMOD_DSP_PARAMETER_TYPE_FLOAT: return Host_SetParameterFloat(host, index, value);
+        case FMOD_DSP_PARAMETER_TYPE_INT:   return Host_SetParameterInt(host, index, (int)value);
+        case FMOD_DSP_PARAMETER_TYPE_BOOL:  return Host_SetParameterBool(host, index, value != 0.0f);
+        default:                            return FMOD_ERR_INVALID_PARAM;
+    }
+}
+
+FMOD_RESULT Host_GetParameterData(Host_Instance *host, int index, void **data, unsigned int *length)
+{
+    if (!host->desc->getparameterdata)
+        return FMOD_ERR_INVALID_PARAM;
+    char valuestr[FMOD_DSP_GETPARAM_VALUESTR_LENGTH];
+    return host->desc->getparameterdata(&host->state, index, data, length, valuestr);
+}
+
+int Host_FindParameter(Host_Instance *host, const char *name)
+{
+    for (int index = 0; index < host->desc->numparameters; index++)
+    {
+        if (strcmp(host->desc->paramdesc[index]->name, name) == 0)
+            return index;
+    }
+    return -1;
+}
+
+FMOD_RESULT Host_ApplyParameter(Host_Instance *host, const char *arg)
+{
+    char name[64];
+    const char *equals = strchr(arg, '=');
+    if (!equals || equals - arg >= (int)sizeof(name))
+        return FMOD_ERR_INVALID_PARAM;
+
+    memcpy(name, arg, equals - arg);
+    name[equals - arg] = 0;
+
+    char *end;
+    int index = (int)strtol(name, &end, 10);
+    if (*end != 0)
+        index = Host_FindParameter(host, name);
+
+    return Host_SetParameter(host, index, (float)atof(equals + 1));
+}
+
+static bool Host_IsSilent(const float *buffer, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (buffer[i] != 0.0f)
+            return false;
+    }
+    return true;
+}
+
+void Host_Seek(Host_Instance *host, unsigned long long clock)
+{
+    host->clock = clock;
+    if (host->desc->setposition)
+        host->desc->setposition(&host->state, (unsigned int)clock);
+}
+
+static FMOD_RESULT Host_ReadUnit(Host_Instance *host, float *inbuffer, float *outbuffer, unsigned int length)
+{
+    FMOD_RESULT result;
+
+    if (host->desc->read)
+    {
+        int outchannels = host->channels;
+        result = host->desc->read(&host->state, inbuffer, outbuffer, length, host->channels, &outchannels);
+        host->clock += length;
+        return result;
+    }
+
+    int              innumchannels = host->channels;
+    int              outnumchannels = host->channels;
+    FMOD_CHANNELMASK inmask = 0;
+    FMOD_CHANNELMASK outmask = 0;
+    float           *inbuffers[1] = { inbuffer };
+    float           *outbuffers[1] = { outbuffer };
+
+    FMOD_DSP_BUFFER_ARRAY inarray;
+    inarray.numbuffers = 1;
+    inarray.buffernumchannels = &innumchannels;
+    inarray.bufferchannelmask = &inmask;
+    inarray.buffers = inbuffers;
+    inarray.speakermode = host->speakermode;
+
+    FMOD_DSP_BUFFER_ARRAY outarray = inarray;
+    outarray.buffernumchannels = &outnumchannels;
+    outarray.bufferchannelmask = &outmask;
+    outarray.buffers = outbuffers;
+
+    FMOD_BOOL inputsidle = Host_IsSilent(inbuffer, (size_t)length * host->channels) ? 1 : 0;
+    result = host->desc->process(&host->state, length, &inarray, &outarray, inputsidle, FMOD_DSP_PROCESS_QUERY);
+    if (result == FMOD_ERR_DSP_DONTPROCESS || result == FMOD_ERR_DSP_SILENCE)
+    {
+        // The mixer would not run the unit and treat its output as silent
+        memset(outbuffer, 0, (size_t)length * host->channels * sizeof(float));
+        host->skipped++;
+        host->clock += length;
+        return FMOD_OK;
+    }
+    if (result != FMOD_OK)
+        return result;
+
+    result = host->desc->process(&host->state, length, &inarray, &outarray, inputsidle, FMOD_DSP_PROCESS_PERFORM);
+    host->clock += length;
+
+    return result;
+}
+
+/*
+    Real time guard. gGuardInside marks a thread that is inside a mixer callback, the interposers in host_guard.cpp
+    ask Host_GuardCheck on every call they wrap. Reports are written with gGuardReporting set, so writing them does
+    not count as a violation itself.
+*/
+#define HOST_GUARD_MAX_REPORTS  16
+#define HOST_GUARD_MAX_FRAMES   32
+
+static std::atomic<bool>               gGuardEnabled(false);
+static std::atomic<bool>               gGuardHooked(false);
+static double                          gGuardBudget = 0.0;
+static std::atomic<unsigned long long> gGuardCalls(0);
+static std::atomic<unsigned long long> gGuardViolations(0);
+static std::atomic<unsigned long long> gGuardOverBudget(0);
+static std::atomic<unsigned long long> gGuardWorstNs(0);
+static std::atomic<unsigned long long> gGuardWorstShare(0);    // Share in millionths
+static thread_local int                gGuardInside = 0;
+static thread_local bool               gGuardReporting = false;
+
+void Host_GuardEnable(double budget)
+{
+#if HOST_GUARD_BACKTRACE
+    // The unwinder loads and allocates on first use, get that done outside any callback
+    void *frames[2];
+    backtrace(frames, 2);
+#endif
+    gGuardCalls = 0;
+    gGuardViolations = 0;
+    gGuardOverBudget = 0;
+    gGuardWorstNs = 0;
+    gGuardWorstShare = 0;
+    gGuardBudget = budget;
+    gGuardEnabled = budget > 0.0;
+}
+
+void Host_GuardRead(Host_GuardStats *stats)
+{
+    stats->hooked = gGuardHooked;
+    stats->calls = gGuardCalls;
+    stats->violations = gGuardViolations;
+    stats->over_budget = gGuardOverBudget;
+    stats->worst_ns = gGuardWorstNs;
+    stats->worst_share = gGuardWorstShare / 1e6;
+}
+
+void Host_GuardRegister()
+{
+    gGuardHooked = true;
+}
+
+void Host_GuardCheck(const char *call, size_t size)
+{
+    if (!gGuardInside || gGuardReporting)
+        return;
+
+    if (++gGuardViolations > HOST_GUARD_MAX_REPORTS)
+        return;
+
+    gGuardReporting = true;
+    fprintf(stderr, "rt guard: %s(%lu) inside a mixer callback\n", call, (unsigned long)size);
+#if HOST_GUARD_BACKTRACE
+    void *frames[HOST_GUARD_MAX_FRAMES];
+    int count = backtrace(frames, HOST_GUARD_MAX_FRAMES);
+    fflush(stderr);
+    backtrace_symbols_fd(frames + 1, count - 1, 2);     // Skips Host_GuardCheck itself
+#endif
+    gGuardReporting = false;
+}
+
+static void Host_GuardRecord(const Host_Instance *host, unsigned int length, unsigned long long elapsed)
+{
+    gGuardCalls++;
+
+    unsigned long long worst = gGuardWorstNs.load();
+    while (elapsed > worst && !gGuardWorstNs.compare_exchange_weak(worst, elapsed))
+        ;
+
+    double share = elapsed / (length * 1e9 / host->samplerate);
+    unsigned long long millionths = (unsigned long long)(share * 1e6);
+    unsigned long long worst_share = gGuardWorstShare.load();
+    while (millionths > worst_share && !gGuardWorstShare.compare_exchange_weak(worst_share, millionths))
+        ;
+
+    if (share > gGuardBudget && ++gGuardOverBudget <= HOST_GUARD_MAX_REPORTS)
+        fprintf(stderr, "rt guard: block of %u frames took %.1f us, %.1f%% of its playing time\n", length, elapsed / 1e3, share * 100.0);
+}
+
+// The mix stages run once through the first unit, the plugin only looks at the system they belong to
+FMOD_RESULT Host_Mix(Host_Instance **hosts, int count, float **inbuffers, float **outbuffers, unsigned int length)
+{
+    if (count <= 0)
+        return FMOD_OK;
+
+    bool guard = gGuardEnabled.load(std::memory_order_relaxed);
+    unsigned long long start = guard ? Host_Clock() : 0;
+    gGuardInside += guard ? 1 : 0;
+
+    if (hosts[0]->desc->sys_mix)
+        hosts[0]->desc->sys_mix(&hosts[0]->state, 0);
+
+    FMOD_RESULT result = FMOD_OK;
+    for (int i = 0; i < count && result == FMOD_OK; i++)
+        result = Host_ReadUnit(hosts[i], inbuffers[i], outbuffers[i], length);
+
+    if (hosts[0]->desc->sys_mix)
+        hosts[0]->desc->sys_mix(&hosts[0]->state, 1);
+
+    gGuardInside -= guard ? 1 : 0;
+    if (guard)
+        Host_GuardRecord(hosts[0], length, Host_Clock() - start);
+
+    return result;
+}
+
+FMOD_RESULT Host_Read(Host_Instance *host, float *inbuffer, float *outbuffer, unsigned int length)
+{
+    return Host_Mix(&host, 1, &inbuffer, &outbuffer, length);
+}
+
+FMOD_RESULT Host_Process(Host_Instance *host, const float *inbuffer, float *outbuffer, unsigned int frames)
+{
+    unsigned int offset = 0;
+
+    // The mixer only ever hands out whole blocks, so the tail goes through a zero padded block
+    while (offset < frames)
+    {
+        unsigned int length = frames - offset;
+        const float *in = inbuffer + (size_t)offset * host->channels;
+        float *out = outbuffer + (size_t)offset * host->channels;
+        FMOD_RESULT result;
+
+        if (length >= host->blocksize)
+        {
+            length = host->blocksize;
+            result = Host_Read(host, (float *)in, out, length);
+        }
+        else
+        {
+            memset(host->scratch_in, 0, host->blocksize * host->channels * sizeof(float));
+            memcpy(host->scratch_in, in, (size_t)length * host->channels * sizeof(float));
+            result = Host_Read(host, host->scratch_in, host->scratch_out, host->blocksize);
+            memcpy(out, host->scratch_out, (size_t)length * host->channels * sizeof(float));
+        }
+
+        if (result != FMOD_OK)
+            return result;
+        offset += length;
+    }
+
+    return FMOD_OK;
+}
+
+/*
+    WAV files. Reads 16/24/32 bit PCM and 32 bit float (plain or WAVE_FORMAT_EXTENSIBLE), always writes 32 bit float.
+*/
+static unsigned int Host_ReadU32(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static unsigned short Host_ReadU16(const unsigned char *p)
+{
+    return (unsigned short)(p[0] | (p[1] << 8));
+}
+
+static void Host_WriteU32(unsigned char *p, unsigned int v)
+{
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static void Host_WriteU16(unsigned char *p, unsigned short v)
+{
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+}
+
+FMOD_RESULT Host_AllocWav(Host_Wav *wav, unsigned int frames, int channels, int samplerate)
+{
+    wav->frames = frames;
+    wav->channels = channels;
+    wav->samplerate = samplerate;
+    wav->samples = (float *)calloc((size_t)frames * channels, sizeof(float));
+    return wav->samples ? FMOD_OK : FMOD_ERR_MEMORY;
+}
+
+void Host_FreeWav(Host_Wav *wav)
+{
+    free(wav->samples);
+    wav->samples = 0;
+    wav->frames = 0;
+}
+
+FMOD_RESULT Host_ParseWav(const unsigned char *mem, size_t size, Host_WavView *view)
+{
+    if (size < 12 || memcmp(mem, "RIFF", 4) != 0 || memcmp(mem + 8, "WAVE", 4) != 0)
+        return FMOD_ERR_FORMAT;
+
+    unsigned short format = 0, channels = 0, bits = 0;
+    unsigned int samplerate = 0;
+    const unsigned char *pcm = 0;
+    unsigned int pcmbytes = 0;
+
+    size_t pos = 12;
+    while (pos + 8 <= size)
+    {
+        const unsigned char *chunk = mem + pos;
+        unsigned int chunksize = Host_ReadU32(chunk + 4);
+        if (chunksize > size - pos - 8)
+            chunksize = (unsigned int)(size - pos - 8);
+
+        if (memcmp(chunk, "fmt ", 4) == 0 && chunksize >= 16)
+        {
+            format = Host_ReadU16(chunk + 8);
+            channels = Host_ReadU16(chunk + 10);
+            samplerate = Host_ReadU32(chunk + 12);
+            bits = Host_ReadU16(chunk + 22);
+            if (format == 0xFFFE && chunksize >= 26)
+                format = Host_ReadU16(chunk + 32);      // Sub format GUID starts with the format tag
+        }
+        else if (memcmp(chunk, "data", 4) == 0)
+        {
+            pcm = chunk + 8;
+            pcmbytes = chunksize;
+        }
+
+        pos += 8 + (size_t)chunksize + (chunksize & 1);
+    }
+
+    bool supported = (format == 1 && (bits == 16 || bits == 24 || bits == 32)) || (format == 3 && bits == 32);
+    if (!pcm || !channels || !supported)
+        return FMOD_ERR_FORMAT;
+
+    view->pcm = pcm;
+    view->frames = pcmbytes / (bits / 8 * channels);
+    view->channels = channels;
+    view->samplerate = (int)samplerate;
+    view->format = format;
+    view->bits = bits;
+    return FMOD_OK;
+}
+
+void Host_DecodeWav(const Host_WavView *view, unsigned int first, unsigned int frames, float *out)
+{
+    unsigned int bytes = view->bits / 8;
+    size_t count = (size_t)frames * view->channels;
+    const unsigned char *pcm = view->pcm + (size_t)first * view->channels * bytes;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const unsigned char *p = pcm + i * bytes;
+        if (view->format == 3)
+        {
+            unsigned int u = Host_ReadU32(p);
+            memcpy(&out[i], &u, sizeof(float));
+        }
+        else if (view->bits == 16)
+            out[i] = (short)Host_ReadU16(p) / 32768.0f;
+        else if (view->bits == 24)
+            out[i] = (float)((int)((p[0] << 8) | (p[1] << 16) | ((unsigned int)p[2] << 24)) >> 8) / 8388608.0f;
+        else
+            out[i] = (float)((int)Host_ReadU32(p) / 2147483648.0);
+    }
+}
+
+FMOD_RESULT Host_LoadWav(const char *path, Host_Wav *wav)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return FMOD_ERR_FILE_NOTFOUND;
+
+    fseek(file, 0, SEEK_END);
+    long len = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    unsigned char *mem = (unsigned char *)malloc(len);
+    if (!mem)
+    {
+        fclose(file);
+        return FMOD_ERR_MEMORY;
+    }
+    size_t read = fread(mem, 1, len, file);
+    fclose(file);
+
+    Host_WavView view;
+    FMOD_RESULT result = Host_ParseWav(mem, read, &view);
+    if (result == FMOD_OK)
+        result = Host_AllocWav(wav, view.frames, view.channels, view.samplerate);
+    if (result == FMOD_OK)
+        Host_DecodeWav(&view, 0, view.frames, wav->samples);
+
+    free(mem);
+    return result;
+}
+
+FMOD_RESULT Host_WriteWavHeader(FILE *file, unsigned int frames, int channels, int samplerate)
+{
+    unsigned int databytes = frames * channels * sizeof(float);
+    unsigned char header[44];
+
+    memcpy(header, "RIFF", 4);
+    Host_WriteU32(header + 4, 36 + databytes);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    Host_WriteU32(header + 16, 16);
+    Host_WriteU16(header + 20, 3);
+    Host_WriteU16(header + 22, (unsigned short)channels);
+    Host_WriteU32(header + 24, samplerate);
+    Host_WriteU32(header + 28, samplerate * channels * sizeof(float));
+    Host_WriteU16(header + 32, (unsigned short)(channels * sizeof(float)));
+    Host_WriteU16(header + 34, 32);
+    memcpy(header + 36, "data", 4);
+    Host_WriteU32(header + 40, databytes);
+
+    return fwrite(header, 1, sizeof(header), file) == sizeof(header) ? FMOD_OK : FMOD_ERR_FILE_BAD;
+}
+
+FMOD_RESULT Host_SaveWav(const char *path, const Host_Wav *wav)
+{
+    FILE *file = fopen(path, "wb");
+    if (!file)
+        return FMOD_ERR_FILE_NOTFOUND;
+
+    unsigned int databytes = wav->frames * wav->channels * sizeof(float);
+    bool ok = Host_WriteWavHeader(file, wav->frames, wav->channels, wav->samplerate) == FMOD_OK;
+    ok = ok && fwrite(wav->samples, 1, databytes, file) == databytes;     // Little endian hosts only
+    fclose(file);
+
+    return ok ? FMOD_OK : FMOD_ERR_FILE_BAD;
+}
+
+/*
+    Synthetic speech-like test signal: a vibrato'd harmonic stack gated into syllables, same on every channel
+    apart from a small per channel detune. Deterministic for a given seed.
+*/
+void Host_GenerateVoice(Host_Wav *wav, unsigned int seed)
+{
+    const double pi = 3.14159265358979323846;
+    unsigned int state = seed * 747796405u + 2891336453u;
+
+    for (int chan = 0; chan < wav->channels; chan++)
+    {
+        double phase = 0.0;
+        double pitch = 140.0 + chan * 3.0;
+
+        for (unsigned int samp = 0; samp < wav->frames; samp++)
+        {
+            double t = (double)samp / wav->samplerate;
+            double syllable = fmod(t * 4.0, 1.0);
+            double envelope = syllable < 0.7 ? sin(pi * syllable / 0.7) : 0.0;
+
+            if (samp % 4096 == 0)
+            {
+                state = state * 747796405u + 2891336453u;
+                pitch = 120.0 + (state >> 24) * 0.25 + chan * 3.0;
+            }
+
+            phase += 2.0 * pi * pitch * (1.0 + 0.01 * sin(2.0 * pi * 5.0 * t)) / wav->samplerate;
+
+            double value = 0.0;
+            for (int harmonic = 1; harmonic <= 8; harmonic++)
+                value += sin(phase * harmonic) / harmonic;
+
+            wav->samples[(size_t)samp * wav->channels + chan] = (float)(0.25 * envelope * value);
+        }
+    }
+}
+
+/*
+    Read only file mappings, so large inputs are paged in as they are streamed instead of read up front.
+*/
+FMOD_RESULT Host_MapFile(const char *path, Host_Mapping *mapping)
+{
+    memset(mapping, 0, sizeof(Host_Mapping));
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    if (file == INVALID_HANDLE_VALUE)
+        return FMOD_ERR_FILE_NOTFOUND;
+
+    LARGE_INTEGER size;
+    HANDLE map = GetFileSizeEx(file, &size) && size.QuadPart > 0 ? CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0) : 0;
+    const void *data = map ? MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0) : 0;
+    if (!data)
+    {
+        if (map)
+            CloseHandle(map);
+        CloseHandle(file);
+        return FMOD_ERR_FILE_BAD;
+    }
+
+    mapping->file = file;
+    mapping->map = map;
+    mapping->data = (const unsigned char *)data;
+    mapping->size = (size_t)size.QuadPart;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return FMOD_ERR_FILE_NOTFOUND;
+
+    struct stat info;
+    void *data = fstat(fd, &info) == 0 && info.st_size > 0 ? mmap(0, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (data == MAP_FAILED)
+        return FMOD_ERR_FILE_BAD;
+
+    madvise(data, (size_t)info.st_size, MADV_SEQUENTIAL);
+    mapping->data = (const unsigned char *)data;
+    mapping->size = (size_t)info.st_size;
+#endif
+    return FMOD_OK;
+}
+
+void Host_UnmapFile(Host_Mapping *mapping)
+{
+    if (!mapping->data)
+        return;
+#if defined(_WIN32)
+    UnmapViewOfFile(mapping->data);
+    CloseHandle(mapping->map);
+    CloseHandle(mapping->file);
+#else
+    munmap((void *)mapping->data, mapping->size);
+#endif
+    memset(mapping, 0, sizeof(Host_Mapping));
+}
+
+void Host_InitCase(Host_Case *c, unsigned int blocksize, int channels, int lose_type, int filter_type, const char *suffix)
+{
+    memset(c, 0, sizeof(Host_Case));
+    c->blocksize = blocksize;
+    c->channels = channels;
+    c->lose_type = lose_type;
+    c->filter_type = filter_type;
+
+    char lose[16], filter[16];
+    if (lose_type < 0)
+        strcpy(lose, "off");
+    else
+        sprintf(lose, "%d", lose_type);
+    if (filter_type < 0)
+        strcpy(filter, "off");
+    else
+        sprintf(filter, "%d", filter_type);
+
+    snprintf(c->name, sizeof(c->name), "b%u/c%d/lose-%s/filter-%s%s", blocksize, channels, lose, filter, suffix);
+}
+
+void Host_ApplyCase(Host_Instance *host, const Host_Case *c)
+{
+    if (c->lose_type >= 0)
+    {
+        Host_SetParameter(host, Host_FindParameter(host, "Lose Type"), (float)c->lose_type);
+        Host_SetParameter(host, Host_FindParameter(host, "Lose Samples"), 1.0f);
+    }
+    if (c->filter_type >= 0)
+    {
+        Host_SetParameter(host, Host_FindParameter(host, "Filter Type"), (float)c->filter_type);
+        Host_SetParameter(host, Host_FindParameter(host, "Filter Enabled"), 1.0f);
+    }
+}
+
+const char *Host_IndexField(const char *line, const char *key)
+{
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\": ", key);
+    const char *value = strstr(line, pattern);
+    if (!value)
+        return 0;
+
+    value += strlen(pattern);
+    return *value == '"' ? value + 1 : value;
+}
+
+bool Host_ScanIndex(const char *path, Host_Case *cases, int count, size_t stride, void (*found)(Host_Case *c, const char *line))
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+        return false;
+
+    char line[1024];
+    while (fgets(line, sizeof(line), file))
+    {
+        const char *name = Host_IndexField(line, "name");
+        const char *end = name ? strchr(name, '"') : 0;
+        if (!end)
+            continue;
+
+        for (int i = 0; i < count; i++)
+        {
+            Host_Case *c = (Host_Case *)((char *)cases + i * stride);
+            if (strlen(c->name) == (size_t)(end - name) && strncmp(c->name, name, end - name) == 0)
+                found(c, line);
+        }
+    }
+
+    fclose(file);
+    return true;
+}
+
+unsigned long long Host_Clock()
+{
+    return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,161 @@
+#ifndef INTRF_HOST_H
+#define INTRF_HOST_H
+
+/*==============================================================================
+Headless host for the intRference plugin
+
+Stands in for the FMOD mixer so the plugin can be driven without an FMOD
+System: it fabricates an FMOD_DSP_STATE, fetches the description through
+FMODGetDSPDescription() and runs create / set parameter / read / release in
+the same order the mixer does. Only the FMOD headers are needed, no runtime.
+
+Linux build, with FMOD_INC pointing at the Core API inc directory:
+    g++ -O2 -I$FMOD_INC intrference.cpp intrference_dsp.cpp intrference_pool.cpp intrference_batch.cpp intrference_timing.cpp host.cpp mainHost.cpp -o intrference_host
+==============================================================================*/
+#include "fmod.hpp"
+
+#include <stddef.h>
+#include <stdio.h>
+
+#define HOST_MAX_SYSTEMS 8
+
+typedef struct
+{
+    FMOD_DSP_STATE           state;
+    FMOD_DSP_STATE_FUNCTIONS functions;
+    FMOD_DSP_DESCRIPTION    *desc;
+    bool                     registered;     // sys_register called, sys_deregister still due
+    bool                     owns_system;    // Acquired state.systemobject, gives it back on release
+
+    unsigned int             blocksize;
+    int                      samplerate;
+    int                      channels;
+    FMOD_SPEAKERMODE         speakermode;
+    unsigned long long       clock;          // Frames processed so far, reported through getclock
+    unsigned long long       skipped;        // Blocks the plugin asked the mixer to skip
+
+    float                   *scratch_in;     // Zero padded last block
+    float                   *scratch_out;
+} Host_Instance;
+
+typedef struct
+{
+    float       *samples;                    // Interleaved
+    unsigned int frames;
+    int          channels;
+    int          samplerate;
+} Host_Wav;
+
+// A WAV file in memory, samples decoded on demand
+typedef struct
+{
+    const unsigned char *pcm;
+    unsigned int frames;
+    int          channels;
+    int          samplerate;
+    int          format;                     // 1 PCM, 3 float
+    int          bits;
+} Host_WavView;
+
+typedef struct
+{
+    const unsigned char *data;
+    size_t       size;
+    void        *file;                       // Windows handles, unused elsewhere
+    void        *map;
+} Host_Mapping;
+
+/*
+    Instance lifetime, mirrors what the mixer does around a DSP unit. Host_Create makes every instance its own system,
+    Host_CreateInSystem adds another unit to the system of an existing one: same block size, sample rate and speaker
+    mode, its own channel count, like a mono voice on a stereo mixer. Units of a system are released before the
+    instance that made it.
+*/
+FMOD_RESULT Host_Create(Host_Instance *host, unsigned int blocksize, int samplerate, int channels);
+FMOD_RESULT Host_CreateInSystem(Host_Instance *host, const Host_Instance *system, int channels);
+FMOD_RESULT Host_Release(Host_Instance *host);
+FMOD_RESULT Host_Reset(Host_Instance *host);
+void        Host_Seek(Host_Instance *host, unsigned long long clock);     // Next block starts at this frame of the stream, through setposition
+
+/* Parameters. Host_SetParameter looks the type up in the description and converts */
+FMOD_RESULT Host_SetParameterFloat(Host_Instance *host, int index, float value);
+FMOD_RESULT Host_SetParameterInt(Host_Instance *host, int index, int value);
+FMOD_RESULT Host_SetParameterBool(Host_Instance *host, int index, bool value);
+FMOD_RESULT Host_SetParameter(Host_Instance *host, int index, float value);
+FMOD_RESULT Host_GetParameterData(Host_Instance *host, int index, void **data, unsigned int *length);
+int         Host_FindParameter(Host_Instance *host, const char *name);
+FMOD_RESULT Host_ApplyParameter(Host_Instance *host, const char *arg);     // "name=value" or "index=value", as the tools take -p
+
+/*
+    Processing. Host_Read is one mix of a system with a single unit, Host_Mix one mix of count units of the same
+    system: the pre mix stage, every unit in order, the post mix stage. Host_Process splits any length into blocks.
+    Plugins with a process callback are queried first like the mixer does, an all zero input block counts as idle
+    inputs.
+*/
+FMOD_RESULT Host_Read(Host_Instance *host, float *inbuffer, float *outbuffer, unsigned int length);
+FMOD_RESULT Host_Mix(Host_Instance **hosts, int count, float **inbuffers, float **outbuffers, unsigned int length);
+FMOD_RESULT Host_Process(Host_Instance *host, const float *inbuffer, float *outbuffer, unsigned int frames);
+
+/*
+    Real time guard, for debugging. While enabled every Host_Read counts as one mixer callback and its time is checked
+    against budget, the share of the block's playing time it may take (0 turns the guard off). With host_guard.cpp
+    linked in (glibc), allocations, locks, sleeps and file calls made inside a callback are reported with a backtrace.
+*/
+typedef struct
+{
+    bool         hooked;                     // host_guard.cpp is linked in
+    unsigned long long calls;
+    unsigned long long violations;           // Real time unsafe calls made inside callbacks
+    unsigned long long over_budget;          // Calls that took longer than the budget
+    unsigned long long worst_ns;
+    double       worst_share;                // Largest share of a block's playing time one call took
+} Host_GuardStats;
+
+void        Host_GuardEnable(double budget);
+void        Host_GuardRead(Host_GuardStats *stats);
+void        Host_GuardRegister();                               // Called by host_guard.cpp when it is linked in
+void        Host_GuardCheck(const char *call, size_t size);     // Called by every interposed function
+
+/* Input / output */
+FMOD_RESULT Host_LoadWav(const char *path, Host_Wav *wav);
+FMOD_RESULT Host_SaveWav(const char *path, const Host_Wav *wav);
+FMOD_RESULT Host_ParseWav(const unsigned char *mem, size_t size, Host_WavView *view);
+void        Host_DecodeWav(const Host_WavView *view, unsigned int first, unsigned int frames, float *out);
+FMOD_RESULT Host_WriteWavHeader(FILE *file, unsigned int frames, int channels, int samplerate);
+FMOD_RESULT Host_MapFile(const char *path, Host_Mapping *mapping);
+void        Host_UnmapFile(Host_Mapping *mapping);
+FMOD_RESULT Host_AllocWav(Host_Wav *wav, unsigned int frames, int channels, int samplerate);
+void        Host_GenerateVoice(Host_Wav *wav, unsigned int seed);
+void        Host_FreeWav(Host_Wav *wav);
+
+/*
+    Cases the bench and golden tools render: one layout with one lose and filter setting, named
+    b<blocksize>/c<channels>/lose-<type|off>/filter-<type|off> and the tool's own suffix. Tools put Host_Case first in
+    their own case struct.
+*/
+typedef struct
+{
+    char         name[96];
+    unsigned int blocksize;
+    int          channels;
+    int          lose_type;                  // -1 = lose samples off
+    int          filter_type;                // -1 = filter off
+} Host_Case;
+
+void        Host_InitCase(Host_Case *c, unsigned int blocksize, int channels, int lose_type, int filter_type, const char *suffix);
+void        Host_ApplyCase(Host_Instance *host, const Host_Case *c);       // Lose and filter parameters of the case
+
+/*
+    The tools' result files are their own output, one case object per line. Host_ScanIndex calls found for every line
+    that names one of the count cases, which lie stride bytes apart. Host_IndexField points at the value of key on a
+    line, past the opening quote for strings, or is null.
+*/
+bool        Host_ScanIndex(const char *path, Host_Case *cases, int count, size_t stride, void (*found)(Host_Case *c, const char *line));
+const char *Host_IndexField(const char *line, const char *key);
+
+/* Monotonic clock in nanoseconds */
+unsigned long long Host_Clock();
+
+FMOD_SPEAKERMODE Host_SpeakerMode(int channels);
+
+#endif
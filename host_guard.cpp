@@ -0,0 +1,228 @@
+/*==============================================================================
+Real time guard interposers for the headless host
+
+Linked into a host tool, this file replaces malloc and friends, the blocking
+pthread and semaphore calls, sleeps and plain file I/O for the whole process.
+Each one asks Host_GuardCheck first, which reports the call with a backtrace
+when it happens inside a mixer callback while Host_GuardEnable is on, and then
+forwards to the C library. glibc only; elsewhere this file is empty.
+
+Build it into a tool with -rdynamic, so the calls made from inside the C and
+C++ runtimes are seen too, and without the sanitizers, which interpose the
+same functions:
+    g++ -O2 -rdynamic -I$FMOD_INC intrference.cpp intrference_dsp.cpp intrference_pool.cpp intrference_batch.cpp intrference_timing.cpp host.cpp host_guard.cpp mainHost.cpp -o intrference_host_guard -ldl
+==============================================================================*/
+#ifndef _GNU_SOURCE
+    #define _GNU_SOURCE
+#endif
+
+#include "host.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <atomic>
+
+#if defined(__GLIBC__)
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+    The allocator is reached through glibc's own entry points, dlsym allocates and could not look it up for us. The
+    rest is found with RTLD_NEXT on first use; no function local statics, their guards may take a lock themselves.
+*/
+extern "C"
+{
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t count, size_t size);
+    void *__libc_realloc(void *ptr, size_t size);
+    void *__libc_memalign(size_t alignment, size_t size);
+    void  __libc_free(void *ptr);
+}
+
+static void *Host_GuardNext(std::atomic<void *> *slot, const char *name)
+{
+    void *next = slot->load(std::memory_order_acquire);
+    if (!next)
+    {
+        next = dlsym(RTLD_NEXT, name);
+        slot->store(next, std::memory_order_release);
+    }
+    return next;
+}
+
+#define HOST_GUARD_NEXT(name)   static std::atomic<void *> name##_next(0); \
+                                typedef decltype(&name) name##_type; \
+                                name##_type next = (name##_type)Host_GuardNext(&name##_next, #name)
+
+static bool Host_GuardRegistered()
+{
+    Host_GuardRegister();
+    return true;
+}
+
+static const bool gGuardRegistered = Host_GuardRegistered();
+
+extern "C"
+{
+
+/* Memory */
+void *malloc(size_t size)
+{
+    Host_GuardCheck("malloc", size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    Host_GuardCheck("calloc", count * size);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    Host_GuardCheck("realloc", size);
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+    if (ptr)
+        Host_GuardCheck("free", 0);
+    __libc_free(ptr);
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+    Host_GuardCheck("memalign", size);
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    Host_GuardCheck("aligned_alloc", size);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size)
+{
+    Host_GuardCheck("posix_memalign", size);
+    if (alignment < sizeof(void *) || (alignment & (alignment - 1)) != 0)
+        return 22;      // EINVAL
+    void *block = __libc_memalign(alignment, size);
+    if (!block)
+        return 12;      // ENOMEM
+    *ptr = block;
+    return 0;
+}
+
+/* Locks and waits, a mixer thread that blocks on one is open to priority inversion */
+int pthread_mutex_lock(pthread_mutex_t *mutex)
+{
+    HOST_GUARD_NEXT(pthread_mutex_lock);
+    Host_GuardCheck("pthread_mutex_lock", 0);
+    return next(mutex);
+}
+
+int pthread_rwlock_rdlock(pthread_rwlock_t *lock)
+{
+    HOST_GUARD_NEXT(pthread_rwlock_rdlock);
+    Host_GuardCheck("pthread_rwlock_rdlock", 0);
+    return next(lock);
+}
+
+int pthread_rwlock_wrlock(pthread_rwlock_t *lock)
+{
+    HOST_GUARD_NEXT(pthread_rwlock_wrlock);
+    Host_GuardCheck("pthread_rwlock_wrlock", 0);
+    return next(lock);
+}
+
+int pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex)
+{
+    HOST_GUARD_NEXT(pthread_cond_wait);
+    Host_GuardCheck("pthread_cond_wait", 0);
+    return next(cond, mutex);
+}
+
+int pthread_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex, const struct timespec *abstime)
+{
+    HOST_GUARD_NEXT(pthread_cond_timedwait);
+    Host_GuardCheck("pthread_cond_timedwait", 0);
+    return next(cond, mutex, abstime);
+}
+
+int sem_wait(sem_t *sem)
+{
+    HOST_GUARD_NEXT(sem_wait);
+    Host_GuardCheck("sem_wait", 0);
+    return next(sem);
+}
+
+int nanosleep(const struct timespec *duration, struct timespec *remaining)
+{
+    HOST_GUARD_NEXT(nanosleep);
+    Host_GuardCheck("nanosleep", 0);
+    return next(duration, remaining);
+}
+
+int usleep(useconds_t usec)
+{
+    HOST_GUARD_NEXT(usleep);
+    Host_GuardCheck("usleep", usec);
+    return next(usec);
+}
+
+/* File I/O */
+int open(const char *path, int flags, ...)
+{
+    HOST_GUARD_NEXT(open);
+    Host_GuardCheck("open", 0);
+
+    mode_t mode = 0;
+    if (flags & (O_CREAT | O_TMPFILE))
+    {
+        va_list args;
+        va_start(args, flags);
+        mode = (mode_t)va_arg(args, int);
+        va_end(args);
+    }
+    return next(path, flags, mode);
+}
+
+ssize_t read(int fd, void *buffer, size_t count)
+{
+    HOST_GUARD_NEXT(read);
+    Host_GuardCheck("read", count);
+    return next(fd, buffer, count);
+}
+
+ssize_t write(int fd, const void *buffer, size_t count)
+{
+    HOST_GUARD_NEXT(write);
+    Host_GuardCheck("write", count);
+    return next(fd, buffer, count);
+}
+
+FILE *fopen(const char *path, const char *mode)
+{
+    HOST_GUARD_NEXT(fopen);
+    Host_GuardCheck("fopen", 0);
+    return next(path, mode);
+}
+
+size_t fwrite(const void *buffer, size_t size, size_t count, FILE *file)
+{
+    HOST_GUARD_NEXT(fwrite);
+    Host_GuardCheck("fwrite", size * count);
+    return next(buffer, size, count, file);
+}
+
+}
+
+#endif
@@ -6,27 +6,39 @@ Matias Lizana Garc
 #define _CRT_SECURE_NO_WARNINGS
 
 #include "fmod.hpp"
-#include "common.h"
+#include "intrference_dsp.h"
+#include "intrference_pool.h"
+#include "intrference_batch.h"
+#include "intrference_timing.h"
+#include "intrference_triple.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
+#include <atomic>
 
 extern "C" {
 	F_EXPORT FMOD_DSP_DESCRIPTION* F_CALL FMODGetDSPDescription();
 }
 
-#define INTRF_NUM_PARAMETERS 9
+#define INTRF_NUM_PARAMETERS 19
 
 FMOD_RESULT F_CALLBACK IntrfReadCallback(FMOD_DSP_STATE *dsp_state, float *inbuffer, float *outbuffer, unsigned int length, int inchannels, int *outchannels);
+FMOD_RESULT F_CALLBACK IntrfProcessCallback(FMOD_DSP_STATE *dsp_state, unsigned int length, const FMOD_DSP_BUFFER_ARRAY *inbufferarray, FMOD_DSP_BUFFER_ARRAY *outbufferarray, FMOD_BOOL inputsidle, FMOD_DSP_PROCESS_OPERATION op);
 FMOD_RESULT F_CALLBACK IntrfCreateCallback(FMOD_DSP_STATE *dsp_state);
 FMOD_RESULT F_CALLBACK IntrfReleaseCallback(FMOD_DSP_STATE *dsp_state);
 FMOD_RESULT F_CALLBACK IntrfResetCallback(FMOD_DSP_STATE *dsp_state);
+FMOD_RESULT F_CALLBACK IntrfSetPositionCallback(FMOD_DSP_STATE *dsp_state, unsigned int pos);
 FMOD_RESULT F_CALLBACK IntrfSetParamFloatCallback(FMOD_DSP_STATE *dsp_state, int index, float value);
 FMOD_RESULT F_CALLBACK IntrfGetParamFloatCallback(FMOD_DSP_STATE *dsp_state, int index, float *value, char *valstr);
 FMOD_RESULT F_CALLBACK IntrfSetParamIntCallback(FMOD_DSP_STATE* dsp_state, int index, int value);
 FMOD_RESULT F_CALLBACK IntrfGetParamIntCallback(FMOD_DSP_STATE* dsp_state, int index, int *value, char *valstr);
 FMOD_RESULT F_CALLBACK IntrfSetParamBoolCallback(FMOD_DSP_STATE* dsp_state, int index, FMOD_BOOL value);
 FMOD_RESULT F_CALLBACK IntrfGetParamBoolCallback(FMOD_DSP_STATE* dsp_state, int index, FMOD_BOOL* value, char* valstr);
+FMOD_RESULT F_CALLBACK IntrfGetParamDataCallback(FMOD_DSP_STATE* dsp_state, int index, void** value, unsigned int* length, char* valstr);
+FMOD_RESULT F_CALLBACK IntrfSysRegisterCallback(FMOD_DSP_STATE *dsp_state);
+FMOD_RESULT F_CALLBACK IntrfSysDeregisterCallback(FMOD_DSP_STATE *dsp_state);
+FMOD_RESULT F_CALLBACK IntrfSysMixCallback(FMOD_DSP_STATE *dsp_state, int stage);
 
 static FMOD_DSP_PARAMETER_DESC voice_shatter_desc;
 static FMOD_DSP_PARAMETER_DESC noise_volume_desc;
@@ -37,6 +49,16 @@ static FMOD_DSP_PARAMETER_DESC lose_samples_desc;
 static FMOD_DSP_PARAMETER_DESC voice_cutoff_desc;
 static FMOD_DSP_PARAMETER_DESC voice_filter_type_desc;
 static FMOD_DSP_PARAMETER_DESC voice_filter_enabled_desc;
+static FMOD_DSP_PARAMETER_DESC metering_desc;
+static FMOD_DSP_PARAMETER_DESC meter_desc;
+static FMOD_DSP_PARAMETER_DESC batch_desc;
+static FMOD_DSP_PARAMETER_DESC noise_bank_desc;
+static FMOD_DSP_PARAMETER_DESC filter_q_desc;
+static FMOD_DSP_PARAMETER_DESC packet_length_desc;
+static FMOD_DSP_PARAMETER_DESC burst_length_desc;
+static FMOD_DSP_PARAMETER_DESC profiling_desc;
+static FMOD_DSP_PARAMETER_DESC timing_desc;
+static FMOD_DSP_PARAMETER_DESC seed_desc;
 
 FMOD_DSP_PARAMETER_DESC *paramdesc[INTRF_NUM_PARAMETERS] =
 {
@@ -48,13 +70,20 @@ FMOD_DSP_PARAMETER_DESC *paramdesc[INTRF_NUM_PARAMETERS] =
 	&lose_samples_desc,
 	&voice_cutoff_desc,
 	&voice_filter_type_desc,
-	&voice_filter_enabled_desc
+	&voice_filter_enabled_desc,
+	&metering_desc,
+	&meter_desc,
+	&batch_desc,
+	&noise_bank_desc,
+	&filter_q_desc,
+	&packet_length_desc,
+	&burst_length_desc,
+	&profiling_desc,
+	&timing_desc,
+	&seed_desc
 };
 
-float buf0;
-float buf1;
-
-const char* FMOD_Intrference_Lose_Types[3] = { "Constant", "Random", "Buffer" };
+const char* FMOD_Intrference_Lose_Types[4] = { "Constant", "Random", "Buffer", "Packet" };
 const char* FMOD_Intrference_Filter_Types[3] = { "Lowpass", "Highpass", "Bandpass" };
 
 FMOD_DSP_DESCRIPTION FMOD_Intrference_Desc =
@@ -67,9 +96,9 @@ FMOD_DSP_DESCRIPTION FMOD_Intrference_Desc =
 	IntrfCreateCallback,
 	IntrfReleaseCallback,
 	IntrfResetCallback,
-	IntrfReadCallback,
-	0,
 	0,
+	IntrfProcessCallback,
+	IntrfSetPositionCallback,
 	INTRF_NUM_PARAMETERS,
 	paramdesc,
 	IntrfSetParamFloatCallback,
@@ -79,12 +108,12 @@ FMOD_DSP_DESCRIPTION FMOD_Intrference_Desc =
 	IntrfGetParamFloatCallback,
 	IntrfGetParamIntCallback,
 	IntrfGetParamBoolCallback,
-	0, 
+	IntrfGetParamDataCallback,
 	0, 
 	0,   
-	0,
-	0,
-	0
+	IntrfSysRegisterCallback,
+	IntrfSysDeregisterCallback,
+	IntrfSysMixCallback
 };
 
 extern "C"
@@ -95,20 +124,56 @@ extern "C"
 		FMOD_DSP_INIT_PARAMDESC_FLOAT(noise_volume_desc, "Noise Volume", "%", "noise volume in percent", 0, 100, 0);
 		FMOD_DSP_INIT_PARAMDESC_FLOAT(noise_shatter_desc, "Noise Shatter", "%", "noise shatter in percent", 0, 100, 0);
 		FMOD_DSP_INIT_PARAMDESC_FLOAT(lose_rate_desc, "Lose Rate", "%", "percentage of losing samples", 0, 100, 0);
-		FMOD_DSP_INIT_PARAMDESC_INT(lose_type_desc, "Lose Type", "", "type of losing samples", 0, 2, 0, false, FMOD_Intrference_Lose_Types);
+		FMOD_DSP_INIT_PARAMDESC_INT(lose_type_desc, "Lose Type", "", "type of losing samples", 0, 3, 0, false, FMOD_Intrference_Lose_Types);
 		FMOD_DSP_INIT_PARAMDESC_BOOL(lose_samples_desc, "Lose Samples", "", "lose samples active/inactive", false, 0);
-		FMOD_DSP_INIT_PARAMDESC_FLOAT(voice_cutoff_desc, "Voice Cutoff", "%", "cutoff in percent", 0, 100, 0);
+		FMOD_DSP_INIT_PARAMDESC_FLOAT(voice_cutoff_desc, "Voice Cutoff", "Hz", "filter cutoff frequency", 20, 20000, 1000);
 		FMOD_DSP_INIT_PARAMDESC_INT(voice_filter_type_desc, "Filter Type", "", "type of filter", 0, 2, 0, false, FMOD_Intrference_Filter_Types);
 		FMOD_DSP_INIT_PARAMDESC_BOOL(voice_filter_enabled_desc, "Filter Enabled", "", "filter voice active/inactive", false, 0);
+		FMOD_DSP_INIT_PARAMDESC_BOOL(metering_desc, "Metering", "", "keep a copy of the output for Meter", false, 0);
+		FMOD_DSP_INIT_PARAMDESC_DATA(meter_desc, "Meter", "", "last output block, interleaved floats", FMOD_DSP_PARAMETER_DATA_TYPE_USER);
+		FMOD_DSP_INIT_PARAMDESC_BOOL(batch_desc, "Batch", "", "process with the other batched instances, one block later", false, 0);
+		FMOD_DSP_INIT_PARAMDESC_BOOL(noise_bank_desc, "Noise Bank", "", "read noise from the shared bank instead of generating it", false, 0);
+		FMOD_DSP_INIT_PARAMDESC_FLOAT(filter_q_desc, "Filter Q", "", "filter resonance", 0.5f, 10, 0.707f);
+		FMOD_DSP_INIT_PARAMDESC_FLOAT(packet_length_desc, "Packet Length", "ms", "audio per packet for the Packet lose type", 2, 100, 20);
+		FMOD_DSP_INIT_PARAMDESC_FLOAT(burst_length_desc, "Burst Length", "", "mean run of lost packets for the Packet lose type", 1, 20, 1);
+		FMOD_DSP_INIT_PARAMDESC_BOOL(profiling_desc, "Profiling", "", "time every callback for Timing", false, 0);
+		FMOD_DSP_INIT_PARAMDESC_DATA(timing_desc, "Timing", "", "callback cost since profiling started, intrf_timing", FMOD_DSP_PARAMETER_DATA_TYPE_USER);
+		FMOD_DSP_INIT_PARAMDESC_INT(seed_desc, "Seed", "", "random seed, 0 for a different one per instance", 0, 2147483647, 0, false, 0);
+		KernelsInit();
+		NoiseBankInit();
 		return &FMOD_Intrference_Desc;
 	}
 }
 
-typedef struct 
+//Channel count assumed when the speaker mode does not tell (raw or unknown layouts)
+#define INTRF_DEFAULT_CHANNELS 8
+
+//The mixer writes the metered block straight into its back slot, the Meter read takes the newest one
+typedef struct
+{
+	float *slot[3];
+	unsigned int samples[3];							//Samples in each slot, 0 for an empty meter
+	intrf_triple triple;								//Mixer writes, API reads
+} intrf_meter_buffer;
+
+/*
+	Everything that scales with the channel count, in one allocation. The mixer never resizes it: a block wider than
+	the current scratch is processed in runs of frames that fit (ProcessWide) and asks for a new size, the next API
+	call (set parameter, reset, meter read) allocates it and swaps it in, see ScratchService. The filter memory always
+	holds FMOD_MAX_CHANNEL_WIDTH channels for those runs. Every array starts on its own cache line.
+*/
+typedef struct alignas(INTRF_CACHE_LINE)
+{
+	int channels;
+	intrf_meter_buffer meter;	//Copies of the last output blocks while metering
+	float *keep;				//Per frame keep level the loss decisions write, shared by every channel
+	float *mask;				//keep spread to every sample of the frame, what the mixing kernels multiply by
+	float *buf0;				//Filter memory, the two integrator states of each channel's state variable filter
+	float *buf1;
+} intrf_scratch;
+
+typedef struct
 {
-    float *buffer;
-	
-	//Params
 	float voice_shatter;
 	float noise_volume;
 	float noise_shatter;
@@ -118,84 +183,951 @@ typedef struct
 	float voice_cutoff;
 	int filter_type;
 	bool filter_enabled;
+	bool metering;
+	bool batch;
+	bool noise_bank;
+	float filter_q;
+	float packet_length;
+	float burst_length;
+	bool profiling;
+	int seed;
+} intrf_params;
+
+//Slots change hands between setters and mixer, each one on its own line
+typedef struct alignas(INTRF_CACHE_LINE)
+{
+	intrf_params params;
+} intrf_param_slot;
+
+/*
+	The setters edit pending and publish a copy of it, the mixer takes the newest copy once per block, so it never
+	sees a half written set of parameters. Setters are expected one at a time, as FMOD calls them.
+*/
+typedef struct
+{
+	alignas(INTRF_CACHE_LINE) intrf_params pending;		//Setter side, also what the get callbacks report
+	intrf_param_slot slot[3];
+	intrf_triple triple;								//Setters write, mixer reads
+} intrf_param_buffer;
 
-	//Struct params
+//State variable filter coefficients (trapezoidal integration), see SvfCoefs
+typedef struct
+{
+	float a1;
+	float a2;
+	float a3;
+} intrf_svf;
+
+/*
+	Grouped by who writes what: the mixer's own state first, then the lines both sides touch, then what only the API
+	threads use. Instances come from the pool in whole cache lines, so neighbours never share one either.
+*/
+typedef struct 
+{
+	//Hot, mixer only: the generator is read every sample, the rest once per block
+	alignas(INTRF_CACHE_LINE) intrf_rng rng;
+	intrf_rng start;			//Generator at the first frame of the block, see StreamBegin
+	intrf_rng origin;			//Generator at frame 0 for seed
+	intrf_rng_jump stride;		//Jump over the draws of stride_frames frames
+	unsigned int stride_frames;
+	unsigned long long frame;	//Frame of the stream the next block starts at, counts every block read or skipped
+	unsigned long long position;	//Frame start was last stepped to, the next block follows on when it starts there
+	int seed;					//Seed origin was made from, -1 before the first block
+	unsigned int seed_auto;		//Stands in for seed 0, differs between instances
+	bool idle;
+	int batch_ready;			//Batch lane the last block ran on, -1 when it was processed here
+	intrf_params ramp;			//Parameters the previous block ended on, this block ramps from them
+	intrf_svf svf;				//Filter coefficients the previous block ended on
+	intrf_svf svf_target;		//Coefficients for svf_cutoff and svf_q, only recomputed when those change
+	float svf_k;				//Damping, 1 / Q
+	float svf_cutoff;			//Cutoff in Hz svf_target was made for, negative to recompute and jump to it
+	float svf_q;
+	int samplerate;
+	unsigned int packet_left;	//Frames left in the current packet, 0 to decide a new one
+	unsigned int packet_fade;	//Frames left in the crossfade into the current packet
+	float packet_level;			//Keep mask level reached so far
+	float packet_step;			//Level change per frame while fading
+	bool packet_lost;			//Loss channel state: the current packet is dropped
+	bool profiling;				//Timing recorded last block, the counts restart when it turns on
+	unsigned int metered;		//Samples of the last meter block published, 0 for an empty one
+
+	//Shared with the API threads
+	alignas(INTRF_CACHE_LINE) std::atomic<intrf_scratch *> scratch;
+	std::atomic<intrf_scratch *> scratch_in_use;	//Scratch the mixer works with, never freed under it
+	std::atomic<int> scratch_request;				//Channel count the mixer wants, 0 when happy
+	std::atomic<int> batch_lane;					//First batch lane owned, -1 when not batched
+	std::atomic<int> batch_in_use;					//Lane the mixer works with, same protocol as the scratch
+	std::atomic<int> batch_width;					//Channel count of the blocks read, 0 before the first
+	std::atomic<bool> reset_pending;				//Set by the reset callback, the mixer starts its next block over
+	std::atomic<long long> seek_pending;			//Frame the next block starts at, INTRF_NO_SEEK when it follows on
+	
+	//Params
+	intrf_param_buffer params;
+
+	//Written by the mixer while profiling, read through the Timing parameter
+	intrf_timing_buffer timing;
+
+	//Cold, API threads only
+	alignas(INTRF_CACHE_LINE) intrf_scratch *scratch_retired;	//Replaced but possibly still in use, freed by a later call
+	int   batch_retired;										//Lane given up but possibly still in use
+	int   batch_channels;										//Lanes owned from batch_lane on
 	int   length_samples;
-    int   channels;
 
 } intrf_data;
 
-float FilterProcess(float cutoff, float inputValue, int mode);
+static_assert(alignof(intrf_data) <= INTRF_POOL_ALIGN, "pool blocks must satisfy the instance alignment");
 
-FMOD_RESULT F_CALLBACK IntrfReadCallback(FMOD_DSP_STATE *dsp_state, float *inbuffer, float *outbuffer, unsigned int length, int inchannels, int *outchannels) 
+//Crossfade at every change between kept and lost packets
+#define INTRF_PACKET_FADE_MS 2
+
+//Draws per generator lane set aside for every frame, a block's substream is this many times its length
+#define INTRF_RNG_FRAME_DRAWS 16
+
+//Values fixed for the duration of one read callback
+typedef struct
 {
+	intrf_mix_gains gains;
+	intrf_svf filter;			//Coefficients ramp from filter by filter_step per frame
+	intrf_svf filter_step;
+	float filter_k;
+	unsigned int sample_losed_max;
+	unsigned int sample_losed;
+	unsigned int packet_frames;	//Packet lose type: frames per packet and per crossfade, burst model transitions
+	unsigned int packet_fade_frames;
+	float packet_enter;			//Chance a kept packet is followed by a lost one
+	float packet_leave;			//Chance a lost packet is followed by a kept one
+	unsigned long long position;	//Stream frame of the block's first frame
+	intrf_scratch *scratch;
+	float *meter;				//Null with metering off
+	const float *noise;			//Window of the noise bank for this block, null to generate the noise
+} intrf_block;
+
+typedef void (*intrf_lose_func)(intrf_data *data, const intrf_block *block, float *keep, unsigned int length);
+
+/*
+	Processing is specialized at compile time on the mode combination: LOSE is 0 for off or lose_type + 1, FILTER is
+	0 for off or filter_type + 1, CHANNELS is 0 for a runtime channel count. The read callback picks the instantiation
+	once per block from process_table, so none of the inner loops test a mode.
+*/
+typedef void (*intrf_process_func)(intrf_data *data, const intrf_block *block, float *inbuffer, float *outbuffer, unsigned int length, int channels);
+
+static std::atomic<unsigned int> instance_count(0);
+
+static void ParamsInit(intrf_param_buffer *params) {
+	for (int i = 0; i < 3; i++)
+		params->slot[i].params = params->pending;
+	TripleInit(&params->triple);
+}
+
+static void ParamsPublish(intrf_param_buffer *params) {
+	params->slot[params->triple.back].params = params->pending;
+	TriplePublish(&params->triple);
+}
+
+static const intrf_params* ParamsAcquire(intrf_param_buffer *params) {
+	return &params->slot[TripleAcquire(&params->triple)].params;
+}
+
+static int SpeakerModeChannels(FMOD_SPEAKERMODE speakermode) {
+	switch (speakermode) {
+		case FMOD_SPEAKERMODE_MONO:
+			return 1;
+		case FMOD_SPEAKERMODE_STEREO:
+			return 2;
+		case FMOD_SPEAKERMODE_QUAD:
+			return 4;
+		case FMOD_SPEAKERMODE_SURROUND:
+			return 5;
+		case FMOD_SPEAKERMODE_5POINT1:
+			return 6;
+		case FMOD_SPEAKERMODE_7POINT1:
+			return 8;
+		case FMOD_SPEAKERMODE_7POINT1POINT4:
+			return 12;
+		default:
+			return INTRF_DEFAULT_CHANNELS;
+	}
+}
+
+//Rounds a float count up to whole cache lines
+static size_t ScratchFloats(size_t count) {
+	const size_t line = INTRF_CACHE_LINE / sizeof(float);
+	return (count + line - 1) / line * line;
+}
+
+static intrf_scratch* ScratchCreate(FMOD_DSP_STATE *dsp_state, unsigned int blocksize, int channels) {
+	size_t samples = ScratchFloats((size_t)blocksize * channels);
+	size_t frames = ScratchFloats(blocksize);
+	size_t state = ScratchFloats(FMOD_MAX_CHANNEL_WIDTH);
+	intrf_scratch *scratch = (intrf_scratch *)PoolAlloc(dsp_state, sizeof(intrf_scratch) + (samples * 4 + frames + state * 2) * sizeof(float));
+	if (!scratch)
+		return 0;
+
+	scratch->channels = channels;
+	for (int i = 0; i < 3; i++)
+		scratch->meter.slot[i] = (float *)(scratch + 1) + samples * i;
+	TripleInit(&scratch->meter.triple);
+	scratch->keep = scratch->meter.slot[2] + samples;
+	scratch->mask = scratch->keep + frames;
+	scratch->buf0 = scratch->mask + samples;
+	scratch->buf1 = scratch->buf0 + state;
+	return scratch;
+}
+
+//Mixer side: hands the back slot, samples long, to the Meter read and takes the slot it gave up as the new back
+static void MeterPublish(intrf_meter_buffer *meter, unsigned int samples) {
+	meter->samples[meter->triple.back] = samples;
+	TriplePublish(&meter->triple);
+}
+
+//API side: the newest block published
+static const float* MeterRead(intrf_meter_buffer *meter, unsigned int *samples) {
+	int front = TripleAcquire(&meter->triple);
+	*samples = meter->samples[front];
+	return meter->slot[front];
+}
+
+//Mixer side: publishes the scratch it is about to use and makes sure it was not replaced in between
+static intrf_scratch* ScratchAcquire(intrf_data *data) {
+	intrf_scratch *scratch;
+	do {
+		scratch = data->scratch.load();
+		data->scratch_in_use.store(scratch);
+	} while (data->scratch.load() != scratch);
+	return scratch;
+}
+
+//API side, never called by the mixer: frees what the mixer let go of and serves pending size requests
+static void ScratchService(FMOD_DSP_STATE *dsp_state) {
 	intrf_data *data = (intrf_data *)dsp_state->plugindata;
+	if (data->scratch_retired && data->scratch_in_use.load() != data->scratch_retired)
+	{
+		PoolFree(data->scratch_retired);
+		data->scratch_retired = 0;
+	}
 
-	float data_vs = (float)(data->voice_shatter / 100);
-	float data_ns = (float)(data->noise_shatter / 100);
-	float data_nv = (float)(data->noise_volume / 100);
-	float data_lr = (float)(data->lose_rate / 100) / 2 + 0.5;
-	float data_cutoff = (float)(data->voice_cutoff / 100);
-	int data_lt = data->lose_type;
-	bool data_ls = data->lose_samples;
-	int filter_type = data->filter_type;
-	bool filter_enabled = data->filter_enabled;
-
-	float voice_shatter = 1 - (((float)(rand() % 32768) / 16384.0f) - 1.0f) * data_vs;
-	float noise_shatter = 1 - (((float)(rand() % 32768) / 16384.0f) - 1.0f) * data_ns;
-
-	unsigned int sample_losed_max = data_lr == 1 ? 0 : (int)(1 / (1 - data_lr));
-	unsigned int sample_losed = 0;
-	
-	if (data_lt == 2 && sample_losed_max != 0)
-		sample_losed = rand() % sample_losed_max + 1;
-
-	for (unsigned int samp = 0; samp < length; samp++) 
-    { 
-        for (int chan = 0; chan < *outchannels; chan++)
-        {
-			//Calculates losing samples
-			if (data_lt == 1 && sample_losed_max != 0)
-				sample_losed = rand() % sample_losed_max + 1;
-			else if (data_lt == 0)
-				sample_losed = sample_losed_max;
-
-			//Checks if we have to lose the sample
-			bool add_voice = true;
-			if (data_ls)
-				add_voice = sample_losed_max == 0 ? false : samp % sample_losed == 0;
-
-			//Calculates noise
-			float noise = (((float)(rand() % 32768) / 16384.0f) - 1.0f) * data_nv * 0.02f * noise_shatter;
-
-			//Calculates voice
-			float voice_sample = inbuffer[(samp * inchannels) + chan];
-			if(filter_enabled)
-				voice_sample = FilterProcess(data_cutoff, voice_sample, filter_type);
-			float voice = add_voice ? voice_sample * voice_shatter : 0;
-
-			//Outbuffer
-			outbuffer[(samp * inchannels) + chan] = voice + noise;
-			data->buffer[(samp * *outchannels) + chan] = outbuffer[(samp * inchannels) + chan];
-        }
-    }
+	int channels = data->scratch_request.load();
+	if (channels <= 0 || data->scratch_retired)
+		return;
 
-    return FMOD_OK; 
-} 
+	if (data->scratch.load()->channels != channels)
+	{
+		intrf_scratch *scratch = ScratchCreate(dsp_state, data->length_samples, channels);
+		if (!scratch)
+			return;
+		data->scratch_retired = data->scratch.exchange(scratch);
+	}
+	data->scratch_request.compare_exchange_strong(channels, 0);
+}
 
-float FilterProcess(float cutoff, float inputValue, int mode) {
-	buf0 += cutoff * (inputValue - buf0);
-	buf1 += cutoff * (buf0 - buf1);
-	switch (mode) {
-		case 0:
-			return buf1;
+static int BatchAcquire(intrf_data *data) {
+	int lane;
+	do {
+		lane = data->batch_lane.load();
+		data->batch_in_use.store(lane);
+	} while (data->batch_lane.load() != lane);
+	return lane;
+}
+
+/*
+	API side: follows the Batch parameter and the width of the blocks read, giving lanes back once the mixer let go
+	of them and claiming as many as the blocks have channels. Before the first block the speaker mode has to do.
+*/
+static void BatchService(FMOD_DSP_STATE *dsp_state) {
+	intrf_data *data = (intrf_data *)dsp_state->plugindata;
+	int channels = 0;
+	if (data->params.pending.batch)
+	{
+		channels = data->batch_width.load();
+		if (channels <= 0)
+			channels = data->scratch.load()->channels;
+	}
+
+	if (data->batch_retired < 0 && data->batch_lane.load() >= 0 && channels != data->batch_channels)
+		data->batch_retired = data->batch_lane.exchange(-1);
+
+	if (data->batch_retired >= 0 && data->batch_in_use.load() != data->batch_retired)
+	{
+		BatchRelease(dsp_state->systemobject, data->batch_retired, data->batch_channels);
+		data->batch_retired = -1;
+	}
+
+	if (data->batch_retired < 0 && data->batch_lane.load() < 0 && channels > 0)
+	{
+		data->batch_channels = channels;
+		data->batch_lane.store(BatchClaim(dsp_state, channels));
+	}
+}
+
+//Everything API calls catch up on for the mixer
+static void InstanceService(FMOD_DSP_STATE *dsp_state) {
+	ScratchService(dsp_state);
+	BatchService(dsp_state);
+}
+
+/*
+	Coefficients of the trapezoidal state variable filter for a cutoff in Hz and a Q at the real sample rate. The one
+	tan per change is all the trig there is, blocks only ramp between coefficient sets.
+*/
+static void SvfCoefs(intrf_svf *svf, float *k, float cutoff, float q, int samplerate) {
+	float nyquist = 0.45f * (float)samplerate;
+	if (cutoff > nyquist)
+		cutoff = nyquist;
+	if (cutoff < 1.0f)
+		cutoff = 1.0f;
+	if (q < 0.1f)
+		q = 0.1f;
+
+	float g = tanf(3.14159265f * cutoff / (float)samplerate);
+	*k = 1.0f / q;
+	svf->a1 = 1.0f / (1.0f + g * (g + *k));
+	svf->a2 = g * svf->a1;
+	svf->a3 = g * svf->a2;
+}
+
+//Filter memory below this is as good as silence (-300 dB) and is cleared before it can turn subnormal
+#define INTRF_DENORMAL_FLOOR 1e-15f
+
+static inline float FlushDenormal(float value) {
+	return fabsf(value) < INTRF_DENORMAL_FLOOR ? 0.0f : value;
+}
+
+/*
+	Runs every channel through its own state variable filter, lowpass, highpass or unity peak bandpass by FILTER. With
+	a known channel count the channel loop is fully unrolled and the memory kept in locals, so the channels of a frame
+	run side by side. The coefficients ramp by filter_step per frame
+*/
+template <int FILTER, int CHANNELS>
+static void FilterProcess(intrf_scratch *scratch, const intrf_svf *filter, const intrf_svf *filter_step, float k, const float *inbuffer, float *outbuffer, unsigned int length, int channels) {
+	const int numchannels = CHANNELS ? CHANNELS : channels;
+
+	float local0[CHANNELS ? CHANNELS : 1];
+	float local1[CHANNELS ? CHANNELS : 1];
+	float *buf0 = scratch->buf0;
+	float *buf1 = scratch->buf1;
+	if (CHANNELS)
+	{
+		memcpy(local0, buf0, sizeof(local0));
+		memcpy(local1, buf1, sizeof(local1));
+		buf0 = local0;
+		buf1 = local1;
+	}
+
+	float a1 = filter->a1;
+	float a2 = filter->a2;
+	float a3 = filter->a3;
+	for (unsigned int samp = 0; samp < length; samp++)
+	{
+		const float *in = inbuffer + samp * numchannels;
+		float *out = outbuffer + samp * numchannels;
+		for (int chan = 0; chan < numchannels; chan++)
+		{
+			float input = in[chan];
+			float v3 = input - buf1[chan];
+			float v1 = a1 * buf0[chan] + a2 * v3;
+			float v2 = buf1[chan] + a2 * buf0[chan] + a3 * v3;
+			buf0[chan] = 2.0f * v1 - buf0[chan];
+			buf1[chan] = 2.0f * v2 - buf1[chan];
+			if (FILTER == 1)
+				out[chan] = v2;
+			else if (FILTER == 2)
+				out[chan] = input - k * v1 - v2;
+			else
+				out[chan] = k * v1;
+		}
+		a1 += filter_step->a1;
+		a2 += filter_step->a2;
+		a3 += filter_step->a3;
+	}
+
+	//Memory left this small is flushed, for targets where DenormalsDisable can not help
+	for (int chan = 0; chan < numchannels; chan++)
+	{
+		buf0[chan] = FlushDenormal(buf0[chan]);
+		buf1[chan] = FlushDenormal(buf1[chan]);
+	}
+
+	if (CHANNELS)
+	{
+		memcpy(scratch->buf0, local0, sizeof(local0));
+		memcpy(scratch->buf1, local1, sizeof(local1));
+	}
+}
+
+//Fills keep[from, from + count) with level
+static void KeepSpan(float *keep, unsigned int from, unsigned int count, float level) {
+	if (level == 0.0f)
+	{
+		memset(keep + from, 0, count * sizeof(float));
+		return;
+	}
+	for (unsigned int i = 0; i < count; i++)
+		keep[from + i] = level;
+}
+
+/*
+	Packet lose type: the block is cut into packets that continue across blocks, and a two state Gilbert-Elliott chain
+	decides once per packet whether it is lost. Whole packets are filled at once, a short linear crossfade at each
+	change of state keeps the dropouts from clicking.
+*/
+static void PacketLoseProcess(intrf_data *data, const intrf_block *block, float *keep, unsigned int length) {
+	unsigned int samp = 0;
+	while (samp < length)
+	{
+		if (data->packet_left == 0)
+		{
+			float chance = (float)(RngNextInt(&data->rng) >> 8) * (1.0f / 16777216.0f);
+			data->packet_lost = data->packet_lost ? chance >= block->packet_leave : chance < block->packet_enter;
+			data->packet_left = block->packet_frames - (unsigned int)((block->position + samp) % block->packet_frames);
+
+			float target = data->packet_lost ? 0.0f : 1.0f;
+			data->packet_fade = 0;
+			if (target != data->packet_level)
+			{
+				data->packet_fade = block->packet_fade_frames < block->packet_frames ? block->packet_fade_frames : block->packet_frames;
+				data->packet_step = (target - data->packet_level) / (float)data->packet_fade;
+			}
+		}
+
+		unsigned int span = length - samp < data->packet_left ? length - samp : data->packet_left;
+		unsigned int fade = span < data->packet_fade ? span : data->packet_fade;
+		for (unsigned int i = 0; i < fade; i++)
+		{
+			data->packet_level += data->packet_step;
+			if (data->packet_fade - i == 1)
+				data->packet_level = data->packet_lost ? 0.0f : 1.0f;
+			keep[samp + i] = data->packet_level;
+		}
+		KeepSpan(keep, samp + fade, span - fade, data->packet_level);
+
+		data->packet_fade -= fade;
+		data->packet_left -= span;
+		samp += span;
+	}
+}
+
+/*
+	Decides which frames of the block survive: keep[frame] is 1 or 0 (Packet fades in between). Loss hits whole
+	frames, so this never looks at the channels, MaskSpread lays the result over them.
+*/
+template <int LOSE>
+static void LoseProcess(intrf_data *data, const intrf_block *block, float *keep, unsigned int length) {
+	if (block->sample_losed_max == 0)
+	{
+		memset(keep, 0, length * sizeof(float));
+		return;
+	}
+
+	if (LOSE == 4)
+		PacketLoseProcess(data, block, keep, length);
+	else if (LOSE == 2)
+	{
+		//Random: a new period for every frame
+		for (unsigned int samp = 0; samp < length; samp++)
+		{
+			unsigned int sample_losed = RngNextInt(&data->rng) % block->sample_losed_max + 1;
+			keep[samp] = samp % sample_losed == 0 ? 1.0f : 0.0f;
+		}
+	}
+	else
+	{
+		//Constant and Buffer: one period for the whole block, only every period'th frame is kept
+		unsigned int period = LOSE == 1 ? block->sample_losed_max : block->sample_losed;
+		memset(keep, 0, length * sizeof(float));
+		for (unsigned int samp = 0; samp < length; samp += period)
+			keep[samp] = 1.0f;
+	}
+}
+
+//Repeats each frame's keep level over its channels, mono needs no copy and reads keep directly
+template <int CHANNELS>
+static const float* MaskSpread(const float *keep, float *mask, unsigned int length, int channels) {
+	const int numchannels = CHANNELS ? CHANNELS : channels;
+	if (numchannels == 1)
+		return keep;
+
+	for (unsigned int samp = 0; samp < length; samp++)
+	{
+		float level = keep[samp];
+		float *frame = mask + samp * numchannels;
+		for (int chan = 0; chan < numchannels; chan++)
+			frame[chan] = level;
+	}
+	return mask;
+}
+
+template <int LOSE, int FILTER, int CHANNELS>
+static void ProcessBlock(intrf_data *data, const intrf_block *block, float *inbuffer, float *outbuffer, unsigned int length, int channels) {
+	const int numchannels = CHANNELS ? CHANNELS : channels;
+
+	//Filters the whole block first, the mixing kernel then reads the filtered voice back from outbuffer
+	const float *voice = inbuffer;
+	if (FILTER)
+	{
+		FilterProcess<FILTER, CHANNELS>(block->scratch, &block->filter, &block->filter_step, block->filter_k, inbuffer, outbuffer, length, numchannels);
+		voice = outbuffer;
+	}
+
+	const float *mask = 0;
+	if (LOSE)
+	{
+		LoseProcess<LOSE>(data, block, block->scratch->keep, length);
+		mask = MaskSpread<CHANNELS>(block->scratch->keep, block->scratch->mask, length, numchannels);
+	}
+
+	//Voice with shatter and loss plus noise, written to outbuffer and the metering copy if any
+	if (block->noise && (block->gains.noise != 0.0f || block->gains.noise_step != 0.0f))
+		kernels.bank[LOSE != 0][block->meter != 0](block->noise, voice, mask, outbuffer, block->meter, length * numchannels, &block->gains);
+	else if (block->gains.noise != 0.0f || block->gains.noise_step != 0.0f)
+		kernels.mix[LOSE != 0][block->meter != 0](&data->rng, voice, mask, outbuffer, block->meter, length * numchannels, &block->gains);
+	else
+		kernels.gain[LOSE != 0][block->meter != 0](&data->rng, voice, mask, outbuffer, block->meter, length * numchannels, &block->gains);
+}
+
+static const intrf_lose_func lose_table[5] = { 0, LoseProcess<1>, LoseProcess<2>, LoseProcess<3>, LoseProcess<4> };
+
+#define INTRF_PROCESS_CHANNELS(_lose, _filter) { ProcessBlock<_lose, _filter, 0>, ProcessBlock<_lose, _filter, 1>, ProcessBlock<_lose, _filter, 2>, ProcessBlock<_lose, _filter, 6>, ProcessBlock<_lose, _filter, 8> }
+#define INTRF_PROCESS_FILTERS(_lose) { INTRF_PROCESS_CHANNELS(_lose, 0), INTRF_PROCESS_CHANNELS(_lose, 1), INTRF_PROCESS_CHANNELS(_lose, 2), INTRF_PROCESS_CHANNELS(_lose, 3) }
+
+static const intrf_process_func process_table[5][4][5] =
+{
+	INTRF_PROCESS_FILTERS(0),
+	INTRF_PROCESS_FILTERS(1),
+	INTRF_PROCESS_FILTERS(2),
+	INTRF_PROCESS_FILTERS(3),
+	INTRF_PROCESS_FILTERS(4)
+};
+
+/*
+	A block wider than the scratch, until the API side swaps a wider one in: run through process a few frames at a
+	time, as many as the scratch holds at this width. Each run picks up the gain and filter ramps, the noise window
+	and the stream position where the previous one stopped.
+*/
+static void ProcessWide(intrf_process_func process, intrf_data *data, const intrf_block *block, float *inbuffer, float *outbuffer, unsigned int length, int channels, unsigned int frames) {
+	intrf_block run = *block;
+	for (unsigned int first = 0; first < length; first += frames)
+	{
+		unsigned int count = length - first < frames ? length - first : frames;
+		size_t offset = (size_t)first * channels;
+		run.gains.voice = block->gains.voice + block->gains.voice_step * offset;
+		run.gains.noise = block->gains.noise + block->gains.noise_step * offset;
+		run.filter.a1 = block->filter.a1 + block->filter_step.a1 * first;
+		run.filter.a2 = block->filter.a2 + block->filter_step.a2 * first;
+		run.filter.a3 = block->filter.a3 + block->filter_step.a3 * first;
+		run.position = block->position + first;
+		if (block->noise)
+			run.noise = block->noise + offset;
+		process(data, &run, inbuffer + offset, outbuffer + offset, count, channels);
+	}
+}
+
+/*
+	Most instances sit close to the defaults, so before running the full chain each block is checked for a
+	configuration that reduces to something cheaper. The filter keeps its memory running, so with the filter on
+	only the full chain is used.
+*/
+enum intrf_plan
+{
+	INTRF_PLAN_FULL,
+	INTRF_PLAN_COPY,		//Voice untouched: nothing at all in place, memcpy otherwise
+	INTRF_PLAN_GAIN,		//Shatter only: scaled copy
+	INTRF_PLAN_NOISE,		//Every sample lost: noise only
+	INTRF_PLAN_SILENCE		//Every sample lost and no noise
+};
+
+static intrf_plan PlanBlock(const intrf_block *block, int lose, int filter)
+{
+	if (filter)
+		return INTRF_PLAN_FULL;
+
+	const intrf_mix_gains *gains = &block->gains;
+	bool noise = gains->noise != 0.0f || gains->noise_step != 0.0f;
+	if ((lose && block->sample_losed_max == 0) || (gains->voice == 0.0f && gains->voice_step == 0.0f))
+		return noise ? INTRF_PLAN_NOISE : INTRF_PLAN_SILENCE;
+	if (lose || noise)
+		return INTRF_PLAN_FULL;
+
+	return gains->voice == 1.0f && gains->voice_step == 0.0f ? INTRF_PLAN_COPY : INTRF_PLAN_GAIN;
+}
+
+static int ChannelIndex(int channels)
+{
+	switch (channels) {
 		case 1:
-			return inputValue - buf0;
+			return 1;
 		case 2:
-			return buf0 - buf1;
+			return 2;
+		case 6:
+			return 3;
+		case 8:
+			return 4;
 		default:
-			return 0.0;
+			return 0;
+	}
+}
+
+//Filter taps for the batch pass: input, band (times k) and low, by filter (off, lowpass, highpass, bandpass)
+static const float batch_taps[4][3] = { { 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 1.0f, -1.0f, -1.0f }, { 0.0f, 1.0f, 0.0f } };
+
+/*
+	A batched instance scatters its block into its lanes and plays what the last batch pass made of the block
+	before. The first block on a lane starts it from silence, and so does the first block after a pass that did not
+	run the lane (the instance sat a mix out), its output would be the block played before. Returns false when the block has to be processed
+	here instead (not batched, or the layout does not fit the lanes).
+*/
+static bool BatchProcess(FMOD_DSP_STATE *dsp_state, intrf_data *data, const intrf_block *block, int lose, int filter, float *inbuffer, float *outbuffer, unsigned int length, int channels) {
+	int lane = BatchAcquire(data);
+	if (lane < 0)
+		return false;
+
+	intrf_batch *batch = BatchGet(dsp_state->systemobject);
+	if (!batch || channels != data->batch_channels || length != batch->lanes.frames)
+	{
+		//Off the lane for this block, the API side may give it back right away
+		data->batch_in_use.store(-1);
+		return false;
+	}
+
+	intrf_batch_lanes *lanes = &batch->lanes;
+	float *keep = block->scratch->keep;
+	if (lose)
+		lose_table[lose](data, block, keep, length);
+
+	bool fresh = data->batch_ready != lane || !batch->mixed[lane];
+	for (int chan = 0; chan < channels; chan++)
+	{
+		int l = lane + chan;
+		lanes->rng[l] = RngNextInt(&data->rng) | 1;
+		if (fresh)
+		{
+			lanes->buf0[l] = 0.0f;
+			lanes->buf1[l] = 0.0f;
+		}
+		lanes->buf0[l] = FlushDenormal(lanes->buf0[l]);
+		lanes->buf1[l] = FlushDenormal(lanes->buf1[l]);
+		lanes->a1[l] = block->filter.a1;
+		lanes->a2[l] = block->filter.a2;
+		lanes->a3[l] = block->filter.a3;
+		lanes->a1_step[l] = block->filter_step.a1;
+		lanes->a2_step[l] = block->filter_step.a2;
+		lanes->a3_step[l] = block->filter_step.a3;
+		lanes->tap_input[l] = batch_taps[filter][0];
+		lanes->tap_band[l] = batch_taps[filter][1] * block->filter_k;
+		lanes->tap_low[l] = batch_taps[filter][2];
+		lanes->voice[l] = block->gains.voice;
+		lanes->voice_step[l] = block->gains.voice_step * channels;
+		lanes->noise[l] = block->gains.noise;
+		lanes->noise_step[l] = block->gains.noise_step * channels;
+		lanes->active[l] = 1;
+	}
+	data->batch_ready = lane;
+
+	//Each channel walks its lane's tile, one frame every INTRF_RNG_LANES floats
+	for (int chan = 0; chan < channels; chan++)
+	{
+		int l = lane + chan;
+		size_t offset = (size_t)(l - l % INTRF_RNG_LANES) * length + l % INTRF_RNG_LANES;
+		for (unsigned int samp = 0; samp < length; samp++, offset += INTRF_RNG_LANES)
+		{
+			unsigned int i = samp * channels + chan;
+			float input = inbuffer[i];
+			lanes->input[offset] = input;
+			lanes->mask[offset] = lose ? keep[samp] : 1.0f;
+			outbuffer[i] = fresh ? 0.0f : lanes->output[offset];
+		}
+	}
+
+	if (block->meter)
+		memcpy(block->meter, outbuffer, length * channels * sizeof(float));
+	return true;
+}
+
+#define INTRF_NO_SEEK -1LL
+
+//Mixer side: the frame count jumps where the last reset or setposition put it
+static void StreamSeek(intrf_data *data) {
+	if (data->seek_pending.load(std::memory_order_relaxed) != INTRF_NO_SEEK)
+		data->frame = (unsigned long long)data->seek_pending.exchange(INTRF_NO_SEEK);
+}
+
+/*
+	Every block draws from its own substream of the seed's stream, starting INTRF_RNG_FRAME_DRAWS draws per frame
+	after frame 0. The block's first frame is the instance's own frame count, not the mixer clock: it starts at 0
+	on create and reset and only setposition moves it, so what a block draws depends on the seed and its place in
+	the sound only, whenever the voice started. A render cut into pieces, each set to its first frame, draws what
+	one long render does. A block that follows on from the last one steps the cached stride, anything else jumps
+	from origin. Returns the block's first frame.
+*/
+static unsigned long long StreamBegin(intrf_data *data, int seed, unsigned int length) {
+	unsigned long long position = data->frame;
+	data->frame = position + length;
+
+	if (seed == data->seed && position == data->position)
+		RngJumpApply(&data->start, &data->stride);
+	else
+	{
+		if (seed != data->seed)
+			RngSeed(&data->origin, seed ? (unsigned int)seed : data->seed_auto);
+		data->seed = seed;
+		data->start = data->origin;
+		RngJump(&data->start, position * INTRF_RNG_FRAME_DRAWS);
+	}
+	data->rng = data->start;
+
+	if (length != data->stride_frames)
+	{
+		RngJumpMake(&data->stride, (unsigned long long)length * INTRF_RNG_FRAME_DRAWS);
+		data->stride_frames = length;
+	}
+	data->position = position + length;
+	return position;
+}
+
+//Mixer side half of a reset: filter memory, ramps, the packet state and the batch lanes start over from the current parameters
+static void ResetApply(intrf_data *data, intrf_scratch *scratch, const intrf_params *params) {
+	memset(scratch->buf0, 0, FMOD_MAX_CHANNEL_WIDTH * sizeof(float));
+	memset(scratch->buf1, 0, FMOD_MAX_CHANNEL_WIDTH * sizeof(float));
+	data->ramp = *params;
+	data->svf_cutoff = -1.0f;
+	data->packet_left = 0;
+	data->packet_fade = 0;
+	data->packet_level = 1.0f;
+	data->packet_lost = false;
+	data->batch_ready = -1;
+}
+
+FMOD_RESULT F_CALLBACK IntrfReadCallback(FMOD_DSP_STATE *dsp_state, float *inbuffer, float *outbuffer, unsigned int length, int inchannels, int *outchannels) 
+{
+	intrf_data *data = (intrf_data *)dsp_state->plugindata;
+	*outchannels = inchannels;
+	if (data->batch_width.load(std::memory_order_relaxed) != inchannels)
+		data->batch_width.store(inchannels, std::memory_order_relaxed);
+
+	//One consistent set of parameters for the whole block
+	const intrf_params *params = ParamsAcquire(&data->params);
+	const intrf_params *from = &data->ramp;
+
+	float data_lr = (float)(params->lose_rate / 100) / 2 + 0.5;
+	int data_lt = params->lose_type;
+	bool data_ls = params->lose_samples;
+	int filter_type = params->filter_type;
+	bool filter_enabled = params->filter_enabled;
+
+	//Layout changed: ask for scratch of the right size, meanwhile a wider block runs in pieces the scratch holds
+	intrf_scratch *scratch = ScratchAcquire(data);
+	if (data->reset_pending.exchange(false))
+		ResetApply(data, scratch, params);
+	StreamSeek(data);
+	if (inchannels != scratch->channels)
+		data->scratch_request.store(inchannels);
+	unsigned int wide_frames = 0;
+	if (inchannels > scratch->channels && inchannels <= FMOD_MAX_CHANNEL_WIDTH)
+		wide_frames = data->length_samples * scratch->channels / inchannels;
+	//Wider than FMOD ever delivers, or not one frame fits: nothing safe left but passing it through
+	if (inchannels > scratch->channels && wide_frames == 0)
+	{
+		if (outbuffer != inbuffer)
+			memcpy(outbuffer, inbuffer, length * inchannels * sizeof(float));
+		if (data->metered)
+			MeterPublish(&scratch->meter, 0);
+		data->metered = 0;
+		data->batch_ready = -1;
+		data->frame += length;
+		return FMOD_OK;
+	}
+
+	/*
+		Gains and filter coefficients ramp linearly from the values the previous block ended on to the new ones. The
+		shatter draws stay one per block, only the parameter part of each gain moves across the block.
+	*/
+	unsigned int count = length * inchannels;
+	unsigned long long position = StreamBegin(data, params->seed, length);
+	float voice_rand = RngNext(&data->rng);
+	float noise_rand = RngNext(&data->rng);
+	float voice_from = 1 - voice_rand * (from->voice_shatter / 100);
+	float voice_to = 1 - voice_rand * (params->voice_shatter / 100);
+	float noise_from = from->noise_volume / 100 * 0.02f * (1 - noise_rand * (from->noise_shatter / 100));
+	float noise_to = params->noise_volume / 100 * 0.02f * (1 - noise_rand * (params->noise_shatter / 100));
+
+	if (params->voice_cutoff != data->svf_cutoff || params->filter_q != data->svf_q)
+	{
+		SvfCoefs(&data->svf_target, &data->svf_k, params->voice_cutoff, params->filter_q, data->samplerate);
+		if (data->svf_cutoff < 0.0f)
+			data->svf = data->svf_target;
+		data->svf_cutoff = params->voice_cutoff;
+		data->svf_q = params->filter_q;
+	}
+
+	intrf_block block;
+	block.gains.voice = voice_from;
+	block.gains.voice_step = count ? (voice_to - voice_from) / count : 0.0f;
+	block.gains.noise = noise_from;
+	block.gains.noise_step = count ? (noise_to - noise_from) / count : 0.0f;
+	block.filter = data->svf;
+	block.filter_step.a1 = length ? (data->svf_target.a1 - data->svf.a1) / length : 0.0f;
+	block.filter_step.a2 = length ? (data->svf_target.a2 - data->svf.a2) / length : 0.0f;
+	block.filter_step.a3 = length ? (data->svf_target.a3 - data->svf.a3) / length : 0.0f;
+	block.filter_k = data->svf_k;
+	block.sample_losed_max = data_lr == 1 ? 0 : (int)(1 / (1 - data_lr));
+	block.sample_losed = 0;
+	block.position = position;
+	block.scratch = scratch;
+	block.meter = params->metering && !wide_frames ? scratch->meter.slot[scratch->meter.triple.back] : 0;
+	block.noise = 0;
+
+	//Each block reads the bank from a new random offset, so instances never line up for long
+	if (params->noise_bank && count <= INTRF_NOISE_BANK_SIZE)
+		block.noise = NoiseBank() + RngNextInt(&data->rng) % (INTRF_NOISE_BANK_SIZE - count + 1);
+
+	if (data_lt == 2 && block.sample_losed_max != 0)
+		block.sample_losed = RngNextInt(&data->rng) % block.sample_losed_max + 1;
+
+	/*
+		Packet: Lose Rate is the share of lost packets and Burst Length the mean run of them. Lost runs end with
+		chance 1 / burst, kept ones with the chance that holds the rate; rates too high for the burst stretch it.
+	*/
+	if (data_lt == 3)
+	{
+		float rate = params->lose_rate / 100;
+		float leave = 1.0f / (params->burst_length > 1.0f ? params->burst_length : 1.0f);
+		float enter = rate < 1.0f ? rate * leave / (1.0f - rate) : 1.0f;
+		if (enter > 1.0f)
+		{
+			enter = 1.0f;
+			leave = (1.0f - rate) / rate;
+		}
+		block.packet_enter = enter;
+		block.packet_leave = leave;
+		block.packet_frames = (unsigned int)(params->packet_length * data->samplerate / 1000);
+		if (block.packet_frames == 0)
+			block.packet_frames = 1;
+		block.packet_fade_frames = (unsigned int)(INTRF_PACKET_FADE_MS * data->samplerate / 1000);
+		if (block.packet_fade_frames == 0)
+			block.packet_fade_frames = 1;
 	}
+
+	int lose = data_ls && data_lt >= 0 && data_lt <= 3 ? data_lt + 1 : 0;
+	int filter = filter_enabled && filter_type >= 0 && filter_type <= 2 ? filter_type + 1 : 0;
+
+	data->ramp = *params;
+	data->svf = data->svf_target;
+
+	if (!BatchProcess(dsp_state, data, &block, lose, filter, inbuffer, outbuffer, length, inchannels))
+	{
+		data->batch_ready = -1;
+		switch (PlanBlock(&block, lose, filter)) {
+			case INTRF_PLAN_COPY:
+				if (outbuffer != inbuffer)
+					memcpy(outbuffer, inbuffer, count * sizeof(float));
+				if (block.meter)
+					memcpy(block.meter, inbuffer, count * sizeof(float));
+				break;
+			case INTRF_PLAN_GAIN:
+				kernels.gain[0][block.meter != 0](&data->rng, inbuffer, 0, outbuffer, block.meter, count, &block.gains);
+				break;
+			case INTRF_PLAN_NOISE:
+				if (block.noise)
+					kernels.bank_noise[block.meter != 0](block.noise, 0, 0, outbuffer, block.meter, count, &block.gains);
+				else
+					kernels.noise[block.meter != 0](&data->rng, 0, 0, outbuffer, block.meter, count, &block.gains);
+				break;
+			case INTRF_PLAN_SILENCE:
+				memset(outbuffer, 0, count * sizeof(float));
+				if (block.meter)
+					memset(block.meter, 0, count * sizeof(float));
+				break;
+			default:
+				if (wide_frames)
+					ProcessWide(process_table[lose][filter][0], data, &block, inbuffer, outbuffer, length, inchannels, wide_frames);
+				else
+					process_table[lose][filter][ChannelIndex(inchannels)](data, &block, inbuffer, outbuffer, length, inchannels);
+				break;
+		}
+	}
+
+	//Metering off publishes one empty block, so Meter stops showing the last metered one
+	if (block.meter || data->metered)
+		MeterPublish(&scratch->meter, block.meter ? count : 0);
+	data->metered = block.meter ? count : 0;
+
+    return FMOD_OK; 
+} 
+
+//Anything left ringing in the filter memory above this still has to be played out before going idle
+#define INTRF_FILTER_TAIL_THRESHOLD 1e-6f
+
+static bool FilterTailDone(const intrf_scratch *scratch) {
+	for (int chan = 0; chan < FMOD_MAX_CHANNEL_WIDTH; chan++)
+	{
+		if (fabsf(scratch->buf0[chan]) > INTRF_FILTER_TAIL_THRESHOLD || fabsf(scratch->buf1[chan]) > INTRF_FILTER_TAIL_THRESHOLD)
+			return false;
+	}
+	return true;
+}
+
+/*
+	With silent inputs the plugin only produces output while there is noise to add or a filter tail to play out.
+	Otherwise the query answers FMOD_ERR_DSP_DONTPROCESS and the mixer skips the unit, and the filter memory and
+	metering copy are cleared once so the next sound starts from silence.
+*/
+FMOD_RESULT F_CALLBACK IntrfProcessCallback(FMOD_DSP_STATE *dsp_state, unsigned int length, const FMOD_DSP_BUFFER_ARRAY *inbufferarray, FMOD_DSP_BUFFER_ARRAY *outbufferarray, FMOD_BOOL inputsidle, FMOD_DSP_PROCESS_OPERATION op)
+{
+	intrf_data *data = (intrf_data *)dsp_state->plugindata;
+
+	if (op == FMOD_DSP_PROCESS_QUERY)
+	{
+		if (outbufferarray && inbufferarray)
+		{
+			outbufferarray->bufferchannelmask[0] = inbufferarray->bufferchannelmask[0];
+			outbufferarray->buffernumchannels[0] = inbufferarray->buffernumchannels[0];
+			outbufferarray->speakermode = inbufferarray->speakermode;
+		}
+
+		const intrf_params *params = ParamsAcquire(&data->params);
+		intrf_scratch *scratch = ScratchAcquire(data);
+		bool noise = params->noise_volume != 0.0f || data->ramp.noise_volume != 0.0f;
+		//Instances that ran on a batch lane keep running, their output trails the input by a block
+		bool batched = data->batch_ready >= 0;
+		if (!inputsidle || noise || batched || (params->filter_enabled && !FilterTailDone(scratch)))
+		{
+			data->idle = false;
+			return FMOD_OK;
+		}
+
+		if (!data->idle)
+		{
+			memset(scratch->buf0, 0, FMOD_MAX_CHANNEL_WIDTH * sizeof(float));
+			memset(scratch->buf1, 0, FMOD_MAX_CHANNEL_WIDTH * sizeof(float));
+			if (data->metered && data->metered <= data->length_samples * (unsigned int)scratch->channels)
+			{
+				memset(scratch->meter.slot[scratch->meter.triple.back], 0, data->metered * sizeof(float));
+				MeterPublish(&scratch->meter, data->metered);
+			}
+			data->idle = true;
+		}
+		//Skipped blocks still take their place in the stream
+		StreamSeek(data);
+		data->frame += length;
+		return FMOD_ERR_DSP_DONTPROCESS;
+	}
+
+	bool profiling = ParamsAcquire(&data->params)->profiling;
+	unsigned long long start = profiling ? TimingNow() : 0;
+
+	intrf_fp_mode mode;
+	DenormalsDisable(&mode);
+	FMOD_RESULT result = IntrfReadCallback(dsp_state, inbufferarray->buffers[0], outbufferarray->buffers[0], length, inbufferarray->buffernumchannels[0], &outbufferarray->buffernumchannels[0]);
+	DenormalsRestore(&mode);
+
+	if (profiling)
+	{
+		if (!data->profiling)
+			TimingClear(&data->timing);
+		unsigned long long deadline = (unsigned long long)length * 1000000000ull / (unsigned int)data->samplerate;
+		TimingRecord(&data->timing, TimingNow() - start, deadline, length * inbufferarray->buffernumchannels[0]);
+	}
+	data->profiling = profiling;
+	return result;
 }
 
 FMOD_RESULT F_CALLBACK IntrfCreateCallback(FMOD_DSP_STATE *dsp_state)
@@ -205,25 +1137,56 @@ FMOD_RESULT F_CALLBACK IntrfCreateCallback(FMOD_DSP_STATE *dsp_state)
 
     result = dsp_state->functions->getblocksize(dsp_state, &blocksize);
 
-    intrf_data *data = (intrf_data *)calloc(sizeof(intrf_data), 1);
+    intrf_data *data = (intrf_data *)PoolAlloc(dsp_state, sizeof(intrf_data));
     if (!data)
         return FMOD_ERR_MEMORY;
     
 	dsp_state->plugindata = data;
-	data->voice_shatter = 0.0f;
-	data->noise_volume = 0.0f;
-	data->noise_shatter = 0.0f;
-	data->lose_rate = 0.0f;
-	data->lose_type = false;
-	data->voice_cutoff = 0;
-	data->filter_enabled = false;
-	data->filter_type = 0;
+	data->params.pending.voice_shatter = 0.0f;
+	data->params.pending.noise_volume = 0.0f;
+	data->params.pending.noise_shatter = 0.0f;
+	data->params.pending.lose_rate = 0.0f;
+	data->params.pending.lose_type = false;
+	data->params.pending.voice_cutoff = 1000.0f;
+	data->params.pending.filter_q = 0.707f;
+	data->params.pending.packet_length = 20.0f;
+	data->params.pending.burst_length = 1.0f;
+	data->params.pending.profiling = false;
+	data->params.pending.filter_enabled = false;
+	data->params.pending.filter_type = 0;
+	data->params.pending.metering = false;
+	data->params.pending.batch = false;
+	data->params.pending.noise_bank = false;
+	data->params.pending.seed = 0;
+	ParamsInit(&data->params);
+	TimingInit(&data->timing);
+	data->ramp = data->params.pending;
+	data->batch_lane = -1;
+	data->batch_in_use = -1;
+	data->batch_width = 0;
+	data->batch_retired = -1;
+	data->batch_ready = -1;
+	data->svf_cutoff = -1.0f;
+	data->packet_level = 1.0f;
+	data->samplerate = 48000;
+	dsp_state->functions->getsamplerate(dsp_state, &data->samplerate);
     data->length_samples = blocksize;
-	buf0 = 0;
-	buf1 = 0;
-    data->buffer = (float *)malloc(blocksize * 8 * sizeof(float));      // *8 = maximum size allowing room for 7.1.   Could ask dsp_state->functions->getspeakermode for the right speakermode to get real speaker count.
-    if (!data->buffer)
-        return FMOD_ERR_MEMORY;
+	data->seed_auto = instance_count++ * 0x9E3779B9u ^ (unsigned int)(size_t)data;
+	data->seed = -1;
+	data->seek_pending = INTRF_NO_SEEK;
+	RngSeed(&data->rng, data->seed_auto);
+
+	//Sized for the wider of the mixer and output layouts, the first blocks correct it if the input differs
+	FMOD_SPEAKERMODE speakermode_mixer = FMOD_SPEAKERMODE_DEFAULT;
+	FMOD_SPEAKERMODE speakermode_output = FMOD_SPEAKERMODE_DEFAULT;
+	dsp_state->functions->getspeakermode(dsp_state, &speakermode_mixer, &speakermode_output);
+	int channels = SpeakerModeChannels(speakermode_mixer);
+	if (SpeakerModeChannels(speakermode_output) > channels)
+		channels = SpeakerModeChannels(speakermode_output);
+
+	data->scratch = ScratchCreate(dsp_state, blocksize, channels);
+	if (!data->scratch.load())
+		return FMOD_ERR_MEMORY;
 
     return FMOD_OK;
 }
@@ -234,22 +1197,36 @@ FMOD_RESULT F_CALLBACK IntrfReleaseCallback(FMOD_DSP_STATE *dsp_state)
     {
         intrf_data *data = (intrf_data *)dsp_state->plugindata;
 
-        if (data->buffer)
-			free(data->buffer);
-       
-		free(data);
+		BatchRelease(dsp_state->systemobject, data->batch_lane.load(), data->batch_channels);
+		BatchRelease(dsp_state->systemobject, data->batch_retired, data->batch_channels);
+		PoolFree(data->scratch.load());
+		PoolFree(data->scratch_retired);
+		PoolFree(data);
     }
 
     return FMOD_OK;
 }
 
+//Runs on an API thread, so it only flags the reset and a seek to frame 0, the mixer applies them at the start of its next block
 FMOD_RESULT F_CALLBACK IntrfResetCallback(FMOD_DSP_STATE *dsp_state) {
+	intrf_data *data = (intrf_data *)dsp_state->plugindata;
+	InstanceService(dsp_state);
+	data->seek_pending.store(0);
+	data->reset_pending.store(true);
+	return FMOD_OK;
+}
+
+//Hosts that seek tell the stream where the next block starts, applied by the mixer like a reset
+FMOD_RESULT F_CALLBACK IntrfSetPositionCallback(FMOD_DSP_STATE *dsp_state, unsigned int pos) {
+	intrf_data *data = (intrf_data *)dsp_state->plugindata;
+	InstanceService(dsp_state);
+	data->seek_pending.store(pos);
 	return FMOD_OK;
 }
 
 FMOD_RESULT F_CALLBACK IntrfSetParamFloatCallback(FMOD_DSP_STATE *dsp_state, int index, float value)
 {
-	intrf_data *mydata = (intrf_data *)dsp_state->plugindata;
+	intrf_params *mydata = &((intrf_data *)dsp_state->plugindata)->params.pending;
 	if (index == 0)
 		mydata->voice_shatter = value;
 	else if (index == 1)
@@ -260,14 +1237,22 @@ FMOD_RESULT F_CALLBACK IntrfSetParamFloatCallback(FMOD_DSP_STATE *dsp_state, int
 		mydata->lose_rate = value;
 	else if (index == 6)
 		mydata->voice_cutoff = value;
+	else if (index == 13)
+		mydata->filter_q = value;
+	else if (index == 14)
+		mydata->packet_length = value;
+	else if (index == 15)
+		mydata->burst_length = value;
 	else
 		return FMOD_ERR_INVALID_PARAM;
+	InstanceService(dsp_state);
+	ParamsPublish(&((intrf_data *)dsp_state->plugindata)->params);
 	return FMOD_OK;
 }
 
 FMOD_RESULT F_CALLBACK IntrfGetParamFloatCallback(FMOD_DSP_STATE *dsp_state, int index, float *value, char *)
 {
-	intrf_data *mydata = (intrf_data *)dsp_state->plugindata;
+	intrf_params *mydata = &((intrf_data *)dsp_state->plugindata)->params.pending;
 	if (index == 0)
 		*value = mydata->voice_shatter;
 	else if (index == 1)
@@ -278,6 +1263,12 @@ FMOD_RESULT F_CALLBACK IntrfGetParamFloatCallback(FMOD_DSP_STATE *dsp_state, int
 		*value = mydata->lose_rate;
 	else if (index == 6)
 		*value = mydata->voice_cutoff;
+	else if (index == 13)
+		*value = mydata->filter_q;
+	else if (index == 14)
+		*value = mydata->packet_length;
+	else if (index == 15)
+		*value = mydata->burst_length;
 	else
 		return FMOD_ERR_INVALID_PARAM;
 	return FMOD_OK;
@@ -285,23 +1276,29 @@ FMOD_RESULT F_CALLBACK IntrfGetParamFloatCallback(FMOD_DSP_STATE *dsp_state, int
 
 FMOD_RESULT F_CALLBACK IntrfSetParamIntCallback(FMOD_DSP_STATE* dsp_state, int index, int value)
 {
-	intrf_data* mydata = (intrf_data*)dsp_state->plugindata;
+	intrf_params* mydata = &((intrf_data*)dsp_state->plugindata)->params.pending;
 	if (index == 4)
 		mydata->lose_type = value;
 	else if (index == 7)
 		mydata->filter_type = value;
+	else if (index == 18)
+		mydata->seed = value;
 	else
 		return FMOD_ERR_INVALID_PARAM;
+	InstanceService(dsp_state);
+	ParamsPublish(&((intrf_data*)dsp_state->plugindata)->params);
 	return FMOD_OK;
 }
 
 FMOD_RESULT F_CALLBACK IntrfGetParamIntCallback(FMOD_DSP_STATE* dsp_state, int index, int* value, char*)
 {
-	intrf_data* mydata = (intrf_data*)dsp_state->plugindata;
+	intrf_params* mydata = &((intrf_data*)dsp_state->plugindata)->params.pending;
 	if (index == 4)
 		*value = mydata->lose_type;
 	else if (index == 7)
 		*value = mydata->filter_type;
+	else if (index == 18)
+		*value = mydata->seed;
 	else
 		return FMOD_ERR_INVALID_PARAM;
 	return FMOD_OK;
@@ -309,24 +1306,98 @@ FMOD_RESULT F_CALLBACK IntrfGetParamIntCallback(FMOD_DSP_STATE* dsp_state, int i
 
 FMOD_RESULT F_CALLBACK IntrfSetParamBoolCallback(FMOD_DSP_STATE* dsp_state, int index, FMOD_BOOL value)
 {
-	intrf_data* mydata = (intrf_data*)dsp_state->plugindata;
+	intrf_params* mydata = &((intrf_data*)dsp_state->plugindata)->params.pending;
 	if (index == 5)
 		mydata->lose_samples = value;
 	else if (index == 8)
 		mydata->filter_enabled = value;
+	else if (index == 9)
+		mydata->metering = value;
+	else if (index == 11)
+		mydata->batch = value;
+	else if (index == 12)
+		mydata->noise_bank = value;
+	else if (index == 16)
+		mydata->profiling = value;
 	else
 		return FMOD_ERR_INVALID_PARAM;
+	InstanceService(dsp_state);
+	ParamsPublish(&((intrf_data*)dsp_state->plugindata)->params);
 	return FMOD_OK;
 }
 
 FMOD_RESULT F_CALLBACK IntrfGetParamBoolCallback(FMOD_DSP_STATE* dsp_state, int index, FMOD_BOOL* value, char*)
 {
-	intrf_data* mydata = (intrf_data*)dsp_state->plugindata;
+	intrf_params* mydata = &((intrf_data*)dsp_state->plugindata)->params.pending;
 	if (index == 5)
 		*value = mydata->lose_samples;
 	else if (index == 8)
 		*value = mydata->filter_enabled;
+	else if (index == 9)
+		*value = mydata->metering;
+	else if (index == 11)
+		*value = mydata->batch;
+	else if (index == 12)
+		*value = mydata->noise_bank;
+	else if (index == 16)
+		*value = mydata->profiling;
 	else
 		return FMOD_ERR_INVALID_PARAM;
 	return FMOD_OK;
+}
+
+/*
+	Meter hands out the block the mixer published last, empty while metering is off. Timing hands out an intrf_timing
+	copy. Both stay valid until the next read of the same parameter.
+*/
+FMOD_RESULT F_CALLBACK IntrfGetParamDataCallback(FMOD_DSP_STATE* dsp_state, int index, void** value, unsigned int* length, char*)
+{
+	intrf_data* mydata = (intrf_data*)dsp_state->plugindata;
+	if (index == 17)
+	{
+		*value = (void *)TimingRead(&mydata->timing);
+		*length = sizeof(intrf_timing);
+		return FMOD_OK;
+	}
+	if (index != 10)
+		return FMOD_ERR_INVALID_PARAM;
+
+	InstanceService(dsp_state);
+	unsigned int samples;
+	const float *meter = MeterRead(&mydata->scratch.load()->meter, &samples);
+
+	bool metering = mydata->params.pending.metering && samples;
+	*value = metering ? (void *)meter : 0;
+	*length = metering ? samples * sizeof(float) : 0;
+	return FMOD_OK;
+}
+
+//Instances come from a pool shared by every system the plugin is registered with, batches are per system
+FMOD_RESULT F_CALLBACK IntrfSysRegisterCallback(FMOD_DSP_STATE *dsp_state)
+{
+	PoolRegister();
+	BatchRegister(dsp_state->systemobject);
+	return FMOD_OK;
+}
+
+FMOD_RESULT F_CALLBACK IntrfSysDeregisterCallback(FMOD_DSP_STATE *dsp_state)
+{
+	BatchDeregister(dsp_state->systemobject);
+	PoolDeregister();
+	return FMOD_OK;
+}
+
+//Once every unit of the mix has run, the system's batched instances are processed in one pass
+#define INTRF_MIX_STAGE_POSTMIX 1
+
+FMOD_RESULT F_CALLBACK IntrfSysMixCallback(FMOD_DSP_STATE *dsp_state, int stage)
+{
+	if (stage == INTRF_MIX_STAGE_POSTMIX)
+	{
+		intrf_fp_mode mode;
+		DenormalsDisable(&mode);
+		BatchMix(dsp_state->systemobject);
+		DenormalsRestore(&mode);
+	}
+	return FMOD_OK;
 }
\ No newline at end of file
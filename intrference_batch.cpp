@@ -0,0 +1,148 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "intrference_batch.h"
+#include "intrference_pool.h"
+#include <string.h>
+#include <atomic>
+#include <mutex>
+
+static struct
+{
+	std::mutex lock;
+	std::atomic<intrf_batch *> systems[INTRF_BATCH_SYSTEMS];
+	std::atomic<unsigned int> count[INTRF_BATCH_SYSTEMS];		//Lanes up to the last one in use, whole groups
+	int registrations[INTRF_BATCH_SYSTEMS];
+} batches;
+
+static size_t BatchFloats(size_t count)
+{
+	const size_t line = INTRF_CACHE_LINE / sizeof(float);
+	return (count + line - 1) / line * line;
+}
+
+//Everything in one pool block, every array on its own cache line
+static intrf_batch* BatchCreate(FMOD_DSP_STATE *dsp_state)
+{
+	unsigned int blocksize = 0;
+	if (dsp_state->functions->getblocksize(dsp_state, &blocksize) != FMOD_OK || blocksize == 0)
+		return 0;
+
+	size_t samples = BatchFloats((size_t)blocksize * INTRF_BATCH_LANES);
+	size_t lane = BatchFloats(INTRF_BATCH_LANES);
+	char *memory = (char *)PoolAlloc(dsp_state, BatchFloats(sizeof(intrf_batch)) + (samples * 3 + lane * 18) * sizeof(float));
+	if (!memory)
+		return 0;
+
+	intrf_batch *batch = (intrf_batch *)memory;
+	float *next = (float *)(memory + BatchFloats(sizeof(intrf_batch)));
+	float **arrays[] =
+	{
+		&batch->lanes.buf0, &batch->lanes.buf1,
+		&batch->lanes.a1, &batch->lanes.a2, &batch->lanes.a3, &batch->lanes.a1_step, &batch->lanes.a2_step, &batch->lanes.a3_step,
+		&batch->lanes.tap_input, &batch->lanes.tap_band, &batch->lanes.tap_low,
+		&batch->lanes.voice, &batch->lanes.voice_step, &batch->lanes.noise, &batch->lanes.noise_step
+	};
+
+	batch->lanes.lanes = INTRF_BATCH_LANES;
+	batch->lanes.frames = blocksize;
+	batch->lanes.input = next;
+	batch->lanes.mask = next + samples;
+	batch->lanes.output = next + samples * 2;
+	next += samples * 3;
+	for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++, next += lane)
+		*arrays[i] = next;
+	batch->lanes.rng = (unsigned int *)next;
+	next += lane;
+	batch->lanes.active = (unsigned char *)next;
+	return batch;
+}
+
+int BatchClaim(FMOD_DSP_STATE *dsp_state, int channels)
+{
+	int system = dsp_state->systemobject;
+	if (system < 0 || system >= INTRF_BATCH_SYSTEMS || channels <= 0 || channels > INTRF_BATCH_LANES)
+		return -1;
+
+	std::lock_guard<std::mutex> guard(batches.lock);
+
+	intrf_batch *batch = batches.systems[system].load();
+	if (!batch)
+	{
+		batch = BatchCreate(dsp_state);
+		if (!batch)
+			return -1;
+		batches.systems[system].store(batch);
+	}
+
+	for (int first = 0; first + channels <= INTRF_BATCH_LANES; first++)
+	{
+		int run = 0;
+		while (run < channels && !batch->used[first + run])
+			run++;
+		if (run < channels)
+		{
+			first += run;
+			continue;
+		}
+
+		memset(&batch->used[first], 1, channels);
+		unsigned int end = (unsigned int)(first + channels + INTRF_RNG_LANES - 1) / INTRF_RNG_LANES * INTRF_RNG_LANES;
+		if (end > batches.count[system].load())
+			batches.count[system].store(end);
+		return first;
+	}
+	return -1;
+}
+
+void BatchRelease(int system, int lane, int channels)
+{
+	if (system < 0 || system >= INTRF_BATCH_SYSTEMS || lane < 0)
+		return;
+
+	std::lock_guard<std::mutex> guard(batches.lock);
+
+	intrf_batch *batch = batches.systems[system].load();
+	if (batch)
+		memset(&batch->used[lane], 0, channels);
+}
+
+intrf_batch* BatchGet(int system)
+{
+	if (system < 0 || system >= INTRF_BATCH_SYSTEMS)
+		return 0;
+	return batches.systems[system].load(std::memory_order_acquire);
+}
+
+void BatchMix(int system)
+{
+	intrf_batch *batch = BatchGet(system);
+	if (!batch)
+		return;
+
+	unsigned int count = batches.count[system].load(std::memory_order_relaxed);
+	kernels.batch(&batch->lanes, count);
+	memcpy(batch->mixed, batch->lanes.active, count);
+	memset(batch->lanes.active, 0, count);
+}
+
+void BatchRegister(int system)
+{
+	if (system < 0 || system >= INTRF_BATCH_SYSTEMS)
+		return;
+
+	std::lock_guard<std::mutex> guard(batches.lock);
+	batches.registrations[system]++;
+}
+
+void BatchDeregister(int system)
+{
+	if (system < 0 || system >= INTRF_BATCH_SYSTEMS)
+		return;
+
+	std::lock_guard<std::mutex> guard(batches.lock);
+	if (--batches.registrations[system] > 0)
+		return;
+
+	PoolFree(batches.systems[system].exchange(0));
+	batches.count[system].store(0);
+}
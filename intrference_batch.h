@@ -0,0 +1,43 @@
+#ifndef INTRF_BATCH_H
+#define INTRF_BATCH_H
+
+/*==========================================
+intRference batch engine: instances of one
+system processed together in one pass
+===========================================*/
+
+#include "fmod.hpp"
+#include "intrference_dsp.h"
+
+#define INTRF_BATCH_LANES   256			//Voice channels per system
+#define INTRF_BATCH_SYSTEMS 8			//FMOD systems, indexed by FMOD_DSP_STATE::systemobject
+
+/*
+	Opt-in alternative to running each instance through its own read callback. A batched instance owns a run of
+	lanes in its system's batch: its callback only scatters the block input, mask and per block values into the
+	lanes and gathers what the previous pass produced, and the system mix callback then runs every active lane in
+	one SIMD pass (kernels.batch). The output is one block behind the input.
+
+	Lane ownership changes on API threads only. Lane state is only touched by the mixer, a new owner initializes it
+	on its first block.
+*/
+typedef struct
+{
+	intrf_batch_lanes lanes;
+	unsigned char used[INTRF_BATCH_LANES];			//API side
+	unsigned char mixed[INTRF_BATCH_LANES];			//Mixer side, lanes the last pass ran
+} intrf_batch;
+
+//API side. Returns the first of channels adjacent lanes, -1 when the system is full or unknown
+int BatchClaim(FMOD_DSP_STATE *dsp_state, int channels);
+void BatchRelease(int system, int lane, int channels);
+
+//Mixer side
+intrf_batch* BatchGet(int system);
+void BatchMix(int system);
+
+//System registration, the last deregistration frees the system's batch
+void BatchRegister(int system);
+void BatchDeregister(int system);
+
+#endif
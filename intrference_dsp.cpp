@@ -0,0 +1,779 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "intrference_dsp.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	#define INTRF_X86 1
+	#include <immintrin.h>
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+		#define INTRF_TARGET_SSE2
+		#define INTRF_TARGET_AVX2
+	#else
+		#define INTRF_TARGET_SSE2 __attribute__((target("sse2")))
+		#define INTRF_TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+#else
+	#define INTRF_X86 0
+#endif
+
+intrf_kernels kernels;
+
+alignas(64) static float noise_bank[INTRF_NOISE_BANK_SIZE];
+
+void RngSeed(intrf_rng *rng, unsigned int seed)
+{
+	for (int lane = 0; lane < INTRF_RNG_LANES; lane++)
+	{
+		unsigned int z = seed + 0x9E3779B9u * (lane + 1);
+		z = (z ^ (z >> 16)) * 0x85EBCA6Bu;
+		z = (z ^ (z >> 13)) * 0xC2B2AE35u;
+		z ^= z >> 16;
+		rng->lane[lane] = z ? z : 1;		// xorshift never leaves zero
+	}
+}
+
+unsigned int RngNextInt(intrf_rng *rng)
+{
+	unsigned int x = rng->lane[0];
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	rng->lane[0] = x;
+	return x;
+}
+
+//Uniform in [-1, 1)
+float RngNext(intrf_rng *rng)
+{
+	return (float)(int)RngNextInt(rng) * (1.0f / 2147483648.0f);
+}
+
+//Fills out with uniform values in [-1, 1), stepping every lane once per group of INTRF_RNG_LANES
+void RngFill(intrf_rng *rng, float *out, unsigned int count)
+{
+	unsigned int lane[INTRF_RNG_LANES];
+	memcpy(lane, rng->lane, sizeof(lane));
+
+	for (unsigned int i = 0; i < count; i += INTRF_RNG_LANES)
+	{
+		float values[INTRF_RNG_LANES];
+		for (int l = 0; l < INTRF_RNG_LANES; l++)
+		{
+			unsigned int x = lane[l];
+			x ^= x << 13;
+			x ^= x >> 17;
+			x ^= x << 5;
+			lane[l] = x;
+			values[l] = (float)(int)x * (1.0f / 2147483648.0f);
+		}
+
+		unsigned int n = count - i < INTRF_RNG_LANES ? count - i : INTRF_RNG_LANES;
+		memcpy(out + i, values, n * sizeof(float));
+	}
+
+	memcpy(rng->lane, lane, sizeof(lane));
+}
+
+//Period of a xorshift32 lane, stepping that often is the identity
+#define INTRF_RNG_PERIOD 0xFFFFFFFFull
+
+static unsigned int RngJumpVector(const intrf_rng_jump *jump, unsigned int x)
+{
+	unsigned int y = 0;
+	for (int bit = 0; bit < 32; bit++)
+		y ^= jump->column[bit] & (0u - ((x >> bit) & 1));
+	return y;
+}
+
+static void RngJumpMultiply(intrf_rng_jump *out, const intrf_rng_jump *a, const intrf_rng_jump *b)
+{
+	intrf_rng_jump product;
+	for (int bit = 0; bit < 32; bit++)
+		product.column[bit] = RngJumpVector(a, b->column[bit]);
+	*out = product;
+}
+
+//One step, then squared: table[k] steps a lane 2^k times
+typedef struct
+{
+	intrf_rng_jump power[32];
+} intrf_rng_jump_table;
+
+static intrf_rng_jump_table RngJumpTableMake()
+{
+	intrf_rng_jump_table table;
+	for (int bit = 0; bit < 32; bit++)
+	{
+		unsigned int x = 1u << bit;
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		table.power[0].column[bit] = x;
+	}
+	for (int k = 1; k < 32; k++)
+		RngJumpMultiply(&table.power[k], &table.power[k - 1], &table.power[k - 1]);
+	return table;
+}
+
+static const intrf_rng_jump_table& RngJumpTable()
+{
+	static const intrf_rng_jump_table table = RngJumpTableMake();
+	return table;
+}
+
+void RngJumpMake(intrf_rng_jump *jump, unsigned long long steps)
+{
+	const intrf_rng_jump_table &table = RngJumpTable();
+	steps %= INTRF_RNG_PERIOD;
+
+	for (int bit = 0; bit < 32; bit++)
+		jump->column[bit] = 1u << bit;
+	for (int k = 0; k < 32; k++)
+	{
+		if (steps & (1ull << k))
+			RngJumpMultiply(jump, jump, &table.power[k]);
+	}
+}
+
+//Lanes innermost, so the lanes go through the matrix side by side
+void RngJumpApply(intrf_rng *rng, const intrf_rng_jump *jump)
+{
+	unsigned int out[INTRF_RNG_LANES] = { 0 };
+	for (int bit = 0; bit < 32; bit++)
+	{
+		unsigned int column = jump->column[bit];
+		for (int lane = 0; lane < INTRF_RNG_LANES; lane++)
+			out[lane] ^= column & (0u - ((rng->lane[lane] >> bit) & 1));
+	}
+	memcpy(rng->lane, out, sizeof(out));
+}
+
+void RngJump(intrf_rng *rng, unsigned long long steps)
+{
+	const intrf_rng_jump_table &table = RngJumpTable();
+	steps %= INTRF_RNG_PERIOD;
+
+	for (int k = 0; k < 32; k++)
+	{
+		if (steps & (1ull << k))
+			RngJumpApply(rng, &table.power[k]);
+	}
+}
+
+#if INTRF_X86
+#define INTRF_MXCSR_FTZ 0x8000
+#define INTRF_MXCSR_DAZ 0x0040
+#endif
+
+void DenormalsDisable(intrf_fp_mode *mode)
+{
+#if INTRF_X86
+	unsigned int csr = _mm_getcsr();
+	mode->saved = csr;
+	if ((csr & (INTRF_MXCSR_FTZ | INTRF_MXCSR_DAZ)) != (INTRF_MXCSR_FTZ | INTRF_MXCSR_DAZ))
+		_mm_setcsr(csr | INTRF_MXCSR_FTZ | INTRF_MXCSR_DAZ);
+#elif defined(__aarch64__) && !defined(_MSC_VER)
+	unsigned long long fpcr;
+	__asm__ __volatile__("mrs %0, fpcr" : "=r"(fpcr));
+	mode->saved = fpcr;
+	if (!(fpcr & (1ull << 24)))
+		__asm__ __volatile__("msr fpcr, %0" : : "r"(fpcr | (1ull << 24)));
+#else
+	mode->saved = 0;
+#endif
+}
+
+void DenormalsRestore(const intrf_fp_mode *mode)
+{
+#if INTRF_X86
+	if (_mm_getcsr() != (unsigned int)mode->saved)
+		_mm_setcsr((unsigned int)mode->saved);
+#elif defined(__aarch64__) && !defined(_MSC_VER)
+	__asm__ __volatile__("msr fpcr, %0" : : "r"(mode->saved));
+#else
+	(void)mode;
+#endif
+}
+
+//Fixed seed, every process and every instance sees the same table
+static bool NoiseBankFill()
+{
+	intrf_rng rng;
+	RngSeed(&rng, 0x6E6F6973u);
+	RngFill(&rng, noise_bank, INTRF_NOISE_BANK_SIZE);
+	return true;
+}
+
+void NoiseBankInit()
+{
+	static const bool filled = NoiseBankFill();
+	(void)filled;
+}
+
+const float* NoiseBank()
+{
+	return noise_bank;
+}
+
+/*
+	All mixing kernels are instantiated per active stage: VOICE (voice * voice gain), NOISE (+ noise * noise gain),
+	MASK (voice * mask) and METER (copy of the output). Without NOISE the generator is not stepped at all.
+	Gains ramp linearly with the element index: gain + step * i.
+
+	Reference implementation, the SIMD versions must match it bit for bit. Partial groups still step every lane.
+*/
+template <bool VOICE, bool NOISE, bool MASK, bool METER>
+static inline float MixSample(float voice, float mask, float noise, float index, const intrf_mix_gains *gains)
+{
+	float v = 0.0f;
+	if (VOICE)
+	{
+		v = voice * (gains->voice + gains->voice_step * index);
+		if (MASK)
+			v = v * mask;
+	}
+	if (NOISE)
+	{
+		float n = noise * (gains->noise + gains->noise_step * index);
+		return VOICE ? v + n : n;
+	}
+	return v;
+}
+
+//Mixes n <= INTRF_RNG_LANES elements starting at element offset from already generated noise
+template <bool VOICE, bool NOISE, bool MASK, bool METER>
+static void MixGroup(const float *noise, const float *voice, const float *mask, float *outbuffer, float *meter, unsigned int offset, unsigned int n, const intrf_mix_gains *gains)
+{
+	for (unsigned int j = 0; j < n; j++)
+	{
+		unsigned int i = offset + j;
+		float out = MixSample<VOICE, NOISE, MASK, METER>(VOICE ? voice[i] : 0.0f, MASK ? mask[i] : 1.0f, NOISE ? noise[j] : 0.0f, (float)(int)i, gains);
+		outbuffer[i] = out;
+		if (METER)
+			meter[i] = out;
+	}
+}
+
+template <bool VOICE, bool NOISE, bool MASK, bool METER>
+static void MixScalar(intrf_rng *rng, const float *voice, const float *mask, float *outbuffer, float *meter, unsigned int count, const intrf_mix_gains *gains)
+{
+	float noise[INTRF_RNG_LANES] = { 0 };
+
+	for (unsigned int i = 0; i < count; i += INTRF_RNG_LANES)
+	{
+		if (NOISE)
+			RngFill(rng, noise, INTRF_RNG_LANES);
+
+		unsigned int n = count - i < INTRF_RNG_LANES ? count - i : INTRF_RNG_LANES;
+		MixGroup<VOICE, NOISE, MASK, METER>(noise, voice, mask, outbuffer, meter, i, n, gains);
+	}
+}
+
+//Same mix with the noise read from a window of the noise bank, NOISE implied
+template <bool VOICE, bool MASK, bool METER>
+static void BankScalar(const float *noise, const float *voice, const float *mask, float *outbuffer, float *meter, unsigned int count, const intrf_mix_gains *gains)
+{
+	for (unsigned int i = 0; i < count; i += INTRF_RNG_LANES)
+	{
+		unsigned int n = count - i < INTRF_RNG_LANES ? count - i : INTRF_RNG_LANES;
+		MixGroup<VOICE, true, MASK, METER>(noise + i, voice, mask, outbuffer, meter, i, n, gains);
+	}
+}
+
+/*
+	Batch pass, see intrf_batch_lanes. The reference runs one lane at a time through every frame, the SIMD versions
+	run INTRF_RNG_LANES (AVX2) or half of them (SSE2) side by side with the same operations in the same order.
+*/
+static inline bool BatchGroupActive(const intrf_batch_lanes *batch, unsigned int group)
+{
+	for (unsigned int lane = group; lane < group + INTRF_RNG_LANES; lane++)
+	{
+		if (batch->active[lane])
+			return true;
+	}
+	return false;
+}
+
+static void BatchScalar(const intrf_batch_lanes *batch, unsigned int count)
+{
+	for (unsigned int group = 0; group < count; group += INTRF_RNG_LANES)
+	{
+		if (!BatchGroupActive(batch, group))
+			continue;
+
+		for (unsigned int lane = group; lane < group + INTRF_RNG_LANES; lane++)
+		{
+			unsigned int x = batch->rng[lane];
+			float buf0 = batch->buf0[lane];
+			float buf1 = batch->buf1[lane];
+			float a1 = batch->a1[lane];
+			float a2 = batch->a2[lane];
+			float a3 = batch->a3[lane];
+			size_t offset = (size_t)group * batch->frames + (lane - group);
+
+			for (unsigned int frame = 0; frame < batch->frames; frame++, offset += INTRF_RNG_LANES)
+			{
+				float index = (float)(int)frame;
+				float input = batch->input[offset];
+				float v3 = input - buf1;
+				float v1 = a1 * buf0 + a2 * v3;
+				float v2 = buf1 + a2 * buf0 + a3 * v3;
+				buf0 = 2.0f * v1 - buf0;
+				buf1 = 2.0f * v2 - buf1;
+				float voice = batch->tap_input[lane] * input + batch->tap_band[lane] * v1 + batch->tap_low[lane] * v2;
+				voice = voice * (batch->voice[lane] + batch->voice_step[lane] * index) * batch->mask[offset];
+
+				x ^= x << 13;
+				x ^= x >> 17;
+				x ^= x << 5;
+				float noise = (float)(int)x * (1.0f / 2147483648.0f) * (batch->noise[lane] + batch->noise_step[lane] * index);
+
+				batch->output[offset] = voice + noise;
+				a1 += batch->a1_step[lane];
+				a2 += batch->a2_step[lane];
+				a3 += batch->a3_step[lane];
+			}
+
+			batch->rng[lane] = x;
+			batch->buf0[lane] = buf0;
+			batch->buf1[lane] = buf1;
+		}
+	}
+}
+
+#if INTRF_X86
+
+INTRF_TARGET_SSE2 static inline __m128i XorShiftSSE2(__m128i x)
+{
+	x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+	x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+	return _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+}
+
+template <bool VOICE, bool NOISE, bool MASK>
+INTRF_TARGET_SSE2 static inline __m128 MixSSE2Lanes(const float *voice, const float *mask, __m128 noise, __m128 index, const intrf_mix_gains *gains)
+{
+	__m128 v = _mm_setzero_ps();
+	if (VOICE)
+	{
+		__m128 gain = _mm_add_ps(_mm_set1_ps(gains->voice), _mm_mul_ps(_mm_set1_ps(gains->voice_step), index));
+		v = _mm_mul_ps(_mm_loadu_ps(voice), gain);
+		if (MASK)
+			v = _mm_mul_ps(v, _mm_loadu_ps(mask));
+	}
+	if (NOISE)
+	{
+		__m128 gain = _mm_add_ps(_mm_set1_ps(gains->noise), _mm_mul_ps(_mm_set1_ps(gains->noise_step), index));
+		__m128 n = _mm_mul_ps(noise, gain);
+		return VOICE ? _mm_add_ps(v, n) : n;
+	}
+	return v;
+}
+
+template <bool VOICE, bool NOISE, bool MASK, bool METER>
+INTRF_TARGET_SSE2 static void MixSSE2(intrf_rng *rng, const float *voice, const float *mask, float *outbuffer, float *meter, unsigned int count, const intrf_mix_gains *gains)
+{
+	__m128i lo = _mm_loadu_si128((const __m128i *)&rng->lane[0]);
+	__m128i hi = _mm_loadu_si128((const __m128i *)&rng->lane[4]);
+	__m128i index = _mm_setr_epi32(0, 1, 2, 3);
+	const __m128i four = _mm_set1_epi32(4);
+	const __m128 scale = _mm_set1_ps(1.0f / 2147483648.0f);
+
+	unsigned int i = 0;
+	for (; i + INTRF_RNG_LANES <= count; i += INTRF_RNG_LANES)
+	{
+		if (NOISE)
+		{
+			lo = XorShiftSSE2(lo);
+			hi = XorShiftSSE2(hi);
+		}
+
+		__m128 index0 = _mm_cvtepi32_ps(index);
+		index = _mm_add_epi32(index, four);
+		__m128 index1 = _mm_cvtepi32_ps(index);
+		index = _mm_add_epi32(index, four);
+
+		__m128 out0 = MixSSE2Lanes<VOICE, NOISE, MASK>(voice + i, mask + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale), index0, gains);
+		__m128 out1 = MixSSE2Lanes<VOICE, NOISE, MASK>(voice + i + 4, mask + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale), index1, gains);
+		_mm_storeu_ps(outbuffer + i, out0);
+		_mm_storeu_ps(outbuffer + i + 4, out1);
+		if (METER)
+		{
+			_mm_storeu_ps(meter + i, out0);
+			_mm_storeu_ps(meter + i + 4, out1);
+		}
+	}
+
+	if (i < count)
+	{
+		float noise[INTRF_RNG_LANES];
+		if (NOISE)
+		{
+			lo = XorShiftSSE2(lo);
+			hi = XorShiftSSE2(hi);
+		}
+		_mm_storeu_ps(noise, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+		_mm_storeu_ps(noise + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+		MixGroup<VOICE, NOISE, MASK, METER>(noise, voice, mask, outbuffer, meter, i, count - i, gains);
+	}
+
+	if (NOISE)
+	{
+		_mm_storeu_si128((__m128i *)&rng->lane[0], lo);
+		_mm_storeu_si128((__m128i *)&rng->lane[4], hi);
+	}
+}
+
+template <bool VOICE, bool MASK, bool METER>
+INTRF_TARGET_SSE2 static void BankSSE2(const float *noise, const float *voice, const float *mask, float *outbuffer, float *meter, unsigned int count, const intrf_mix_gains *gains)
+{
+	__m128i index = _mm_setr_epi32(0, 1, 2, 3);
+	const __m128i four = _mm_set1_epi32(4);
+
+	unsigned int i = 0;
+	for (; i + INTRF_RNG_LANES <= count; i += INTRF_RNG_LANES)
+	{
+		__m128 index0 = _mm_cvtepi32_ps(index);
+		index = _mm_add_epi32(index, four);
+		__m128 index1 = _mm_cvtepi32_ps(index);
+		index = _mm_add_epi32(index, four);
+
+		__m128 out0 = MixSSE2Lanes<VOICE, true, MASK>(voice + i, mask + i, _mm_loadu_ps(noise + i), index0, gains);
+		__m128 out1 = MixSSE2Lanes<VOICE, true, MASK>(voice + i + 4, mask + i + 4, _mm_loadu_ps(noise + i + 4), index1, gains);
+		_mm_storeu_ps(outbuffer + i, out0);
+		_mm_storeu_ps(outbuffer + i + 4, out1);
+		if (METER)
+		{
+			_mm_storeu_ps(meter + i, out0);
+			_mm_storeu_ps(meter + i + 4, out1);
+		}
+	}
+
+	if (i < count)
+		MixGroup<VOICE, true, MASK, METER>(noise + i, voice, mask, outbuffer, meter, i, count - i, gains);
+}
+
+INTRF_TARGET_AVX2 static inline __m256i XorShiftAVX2(__m256i x)
+{
+	x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 13));
+	x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 17));
+	return _mm256_xor_si256(x, _mm256_slli_epi32(x, 5));
+}
+
+template <bool VOICE, bool NOISE, bool MASK, bool METER>
+INTRF_TARGET_AVX2 static void MixAVX2(intrf_rng *rng, const float *voice, const float *mask, float *outbuffer, float *meter, unsigned int count, const intrf_mix_gains *gains)
+{
+	__m256i x = _mm256_loadu_si256((const __m256i *)rng->lane);
+	__m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256i eight = _mm256_set1_epi32(8);
+	const __m256 scale = _mm256_set1_ps(1.0f / 2147483648.0f);
+	const __m256 vgain = _mm256_set1_ps(gains->voice);
+	const __m256 vstep = _mm256_set1_ps(gains->voice_step);
+	const __m256 ngain = _mm256_set1_ps(gains->noise);
+	const __m256 nstep = _mm256_set1_ps(gains->noise_step);
+
+	unsigned int i = 0;
+	for (; i + INTRF_RNG_LANES <= count; i += INTRF_RNG_LANES)
+	{
+		__m256 findex = _mm256_cvtepi32_ps(index);
+		index = _mm256_add_epi32(index, eight);
+
+		__m256 out = _mm256_setzero_ps();
+		if (VOICE)
+		{
+			out = _mm256_mul_ps(_mm256_loadu_ps(voice + i), _mm256_add_ps(vgain, _mm256_mul_ps(vstep, findex)));
+			if (MASK)
+				out = _mm256_mul_ps(out, _mm256_loadu_ps(mask + i));
+		}
+		if (NOISE)
+		{
+			x = XorShiftAVX2(x);
+			__m256 noise = _mm256_mul_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(x), scale), _mm256_add_ps(ngain, _mm256_mul_ps(nstep, findex)));
+			out = VOICE ? _mm256_add_ps(out, noise) : noise;
+		}
+
+		_mm256_storeu_ps(outbuffer + i, out);
+		if (METER)
+			_mm256_storeu_ps(meter + i, out);
+	}
+
+	if (i < count)
+	{
+		float noise[INTRF_RNG_LANES];
+		if (NOISE)
+			x = XorShiftAVX2(x);
+		_mm256_storeu_ps(noise, _mm256_mul_ps(_mm256_cvtepi32_ps(x), scale));
+		MixGroup<VOICE, NOISE, MASK, METER>(noise, voice, mask, outbuffer, meter, i, count - i, gains);
+	}
+
+	if (NOISE)
+		_mm256_storeu_si256((__m256i *)rng->lane, x);
+	_mm256_zeroupper();
+}
+
+template <bool VOICE, bool MASK, bool METER>
+INTRF_TARGET_AVX2 static void BankAVX2(const float *noise, const float *voice, const float *mask, float *outbuffer, float *meter, unsigned int count, const intrf_mix_gains *gains)
+{
+	__m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256i eight = _mm256_set1_epi32(8);
+	const __m256 vgain = _mm256_set1_ps(gains->voice);
+	const __m256 vstep = _mm256_set1_ps(gains->voice_step);
+	const __m256 ngain = _mm256_set1_ps(gains->noise);
+	const __m256 nstep = _mm256_set1_ps(gains->noise_step);
+
+	unsigned int i = 0;
+	for (; i + INTRF_RNG_LANES <= count; i += INTRF_RNG_LANES)
+	{
+		__m256 findex = _mm256_cvtepi32_ps(index);
+		index = _mm256_add_epi32(index, eight);
+
+		__m256 out = _mm256_mul_ps(_mm256_loadu_ps(noise + i), _mm256_add_ps(ngain, _mm256_mul_ps(nstep, findex)));
+		if (VOICE)
+		{
+			__m256 v = _mm256_mul_ps(_mm256_loadu_ps(voice + i), _mm256_add_ps(vgain, _mm256_mul_ps(vstep, findex)));
+			if (MASK)
+				v = _mm256_mul_ps(v, _mm256_loadu_ps(mask + i));
+			out = _mm256_add_ps(v, out);
+		}
+
+		_mm256_storeu_ps(outbuffer + i, out);
+		if (METER)
+			_mm256_storeu_ps(meter + i, out);
+	}
+
+	if (i < count)
+		MixGroup<VOICE, true, MASK, METER>(noise + i, voice, mask, outbuffer, meter, i, count - i, gains);
+	_mm256_zeroupper();
+}
+
+INTRF_TARGET_SSE2 static void BatchSSE2(const intrf_batch_lanes *batch, unsigned int count)
+{
+	const __m128 scale = _mm_set1_ps(1.0f / 2147483648.0f);
+	for (unsigned int group = 0; group < count; group += INTRF_RNG_LANES)
+	{
+		if (!BatchGroupActive(batch, group))
+			continue;
+
+		for (unsigned int lane = group; lane < group + INTRF_RNG_LANES; lane += 4)
+		{
+			__m128i x = _mm_loadu_si128((const __m128i *)&batch->rng[lane]);
+			__m128 buf0 = _mm_loadu_ps(&batch->buf0[lane]);
+			__m128 buf1 = _mm_loadu_ps(&batch->buf1[lane]);
+			__m128 a1 = _mm_loadu_ps(&batch->a1[lane]);
+			__m128 a2 = _mm_loadu_ps(&batch->a2[lane]);
+			__m128 a3 = _mm_loadu_ps(&batch->a3[lane]);
+			const __m128 a1_step = _mm_loadu_ps(&batch->a1_step[lane]);
+			const __m128 a2_step = _mm_loadu_ps(&batch->a2_step[lane]);
+			const __m128 a3_step = _mm_loadu_ps(&batch->a3_step[lane]);
+			const __m128 two = _mm_set1_ps(2.0f);
+			const __m128 tap_input = _mm_loadu_ps(&batch->tap_input[lane]);
+			const __m128 tap_band = _mm_loadu_ps(&batch->tap_band[lane]);
+			const __m128 tap_low = _mm_loadu_ps(&batch->tap_low[lane]);
+			const __m128 voice_gain = _mm_loadu_ps(&batch->voice[lane]);
+			const __m128 voice_step = _mm_loadu_ps(&batch->voice_step[lane]);
+			const __m128 noise_gain = _mm_loadu_ps(&batch->noise[lane]);
+			const __m128 noise_step = _mm_loadu_ps(&batch->noise_step[lane]);
+			size_t offset = (size_t)group * batch->frames + (lane - group);
+
+			for (unsigned int frame = 0; frame < batch->frames; frame++, offset += INTRF_RNG_LANES)
+			{
+				__m128 index = _mm_set1_ps((float)(int)frame);
+				__m128 input = _mm_loadu_ps(&batch->input[offset]);
+				__m128 v3 = _mm_sub_ps(input, buf1);
+				__m128 v1 = _mm_add_ps(_mm_mul_ps(a1, buf0), _mm_mul_ps(a2, v3));
+				__m128 v2 = _mm_add_ps(_mm_add_ps(buf1, _mm_mul_ps(a2, buf0)), _mm_mul_ps(a3, v3));
+				buf0 = _mm_sub_ps(_mm_mul_ps(two, v1), buf0);
+				buf1 = _mm_sub_ps(_mm_mul_ps(two, v2), buf1);
+				__m128 voice = _mm_add_ps(_mm_add_ps(_mm_mul_ps(tap_input, input), _mm_mul_ps(tap_band, v1)), _mm_mul_ps(tap_low, v2));
+				voice = _mm_mul_ps(_mm_mul_ps(voice, _mm_add_ps(voice_gain, _mm_mul_ps(voice_step, index))), _mm_loadu_ps(&batch->mask[offset]));
+
+				x = XorShiftSSE2(x);
+				__m128 noise = _mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(x), scale), _mm_add_ps(noise_gain, _mm_mul_ps(noise_step, index)));
+
+				_mm_storeu_ps(&batch->output[offset], _mm_add_ps(voice, noise));
+				a1 = _mm_add_ps(a1, a1_step);
+				a2 = _mm_add_ps(a2, a2_step);
+				a3 = _mm_add_ps(a3, a3_step);
+			}
+
+			_mm_storeu_si128((__m128i *)&batch->rng[lane], x);
+			_mm_storeu_ps(&batch->buf0[lane], buf0);
+			_mm_storeu_ps(&batch->buf1[lane], buf1);
+		}
+	}
+}
+
+INTRF_TARGET_AVX2 static void BatchAVX2(const intrf_batch_lanes *batch, unsigned int count)
+{
+	const __m256 scale = _mm256_set1_ps(1.0f / 2147483648.0f);
+	for (unsigned int lane = 0; lane < count; lane += INTRF_RNG_LANES)
+	{
+		if (!BatchGroupActive(batch, lane))
+			continue;
+
+		__m256i x = _mm256_loadu_si256((const __m256i *)&batch->rng[lane]);
+		__m256 buf0 = _mm256_loadu_ps(&batch->buf0[lane]);
+		__m256 buf1 = _mm256_loadu_ps(&batch->buf1[lane]);
+		__m256 a1 = _mm256_loadu_ps(&batch->a1[lane]);
+		__m256 a2 = _mm256_loadu_ps(&batch->a2[lane]);
+		__m256 a3 = _mm256_loadu_ps(&batch->a3[lane]);
+		const __m256 a1_step = _mm256_loadu_ps(&batch->a1_step[lane]);
+		const __m256 a2_step = _mm256_loadu_ps(&batch->a2_step[lane]);
+		const __m256 a3_step = _mm256_loadu_ps(&batch->a3_step[lane]);
+		const __m256 two = _mm256_set1_ps(2.0f);
+		const __m256 tap_input = _mm256_loadu_ps(&batch->tap_input[lane]);
+		const __m256 tap_band = _mm256_loadu_ps(&batch->tap_band[lane]);
+		const __m256 tap_low = _mm256_loadu_ps(&batch->tap_low[lane]);
+		const __m256 voice_gain = _mm256_loadu_ps(&batch->voice[lane]);
+		const __m256 voice_step = _mm256_loadu_ps(&batch->voice_step[lane]);
+		const __m256 noise_gain = _mm256_loadu_ps(&batch->noise[lane]);
+		const __m256 noise_step = _mm256_loadu_ps(&batch->noise_step[lane]);
+		size_t offset = (size_t)lane * batch->frames;
+
+		for (unsigned int frame = 0; frame < batch->frames; frame++, offset += INTRF_RNG_LANES)
+		{
+			__m256 index = _mm256_set1_ps((float)(int)frame);
+			__m256 input = _mm256_loadu_ps(&batch->input[offset]);
+			__m256 v3 = _mm256_sub_ps(input, buf1);
+			__m256 v1 = _mm256_add_ps(_mm256_mul_ps(a1, buf0), _mm256_mul_ps(a2, v3));
+			__m256 v2 = _mm256_add_ps(_mm256_add_ps(buf1, _mm256_mul_ps(a2, buf0)), _mm256_mul_ps(a3, v3));
+			buf0 = _mm256_sub_ps(_mm256_mul_ps(two, v1), buf0);
+			buf1 = _mm256_sub_ps(_mm256_mul_ps(two, v2), buf1);
+			__m256 voice = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(tap_input, input), _mm256_mul_ps(tap_band, v1)), _mm256_mul_ps(tap_low, v2));
+			voice = _mm256_mul_ps(_mm256_mul_ps(voice, _mm256_add_ps(voice_gain, _mm256_mul_ps(voice_step, index))), _mm256_loadu_ps(&batch->mask[offset]));
+
+			x = XorShiftAVX2(x);
+			__m256 noise = _mm256_mul_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(x), scale), _mm256_add_ps(noise_gain, _mm256_mul_ps(noise_step, index)));
+
+			_mm256_storeu_ps(&batch->output[offset], _mm256_add_ps(voice, noise));
+			a1 = _mm256_add_ps(a1, a1_step);
+			a2 = _mm256_add_ps(a2, a2_step);
+			a3 = _mm256_add_ps(a3, a3_step);
+		}
+
+		_mm256_storeu_si256((__m256i *)&batch->rng[lane], x);
+		_mm256_storeu_ps(&batch->buf0[lane], buf0);
+		_mm256_storeu_ps(&batch->buf1[lane], buf1);
+	}
+	_mm256_zeroupper();
+}
+
+static intrf_simd_level DetectSimd()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	int maxleaf = info[0];
+
+	__cpuid(info, 1);
+	bool sse2 = ((info[3] >> 26) & 1) != 0;
+	bool osxsave = ((info[2] >> 27) & 1) != 0;
+	bool avx = ((info[2] >> 28) & 1) != 0;
+
+	bool avx2 = false;
+	if (maxleaf >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6)
+	{
+		__cpuidex(info, 7, 0);
+		avx2 = ((info[1] >> 5) & 1) != 0;
+	}
+#else
+	__builtin_cpu_init();
+	bool sse2 = __builtin_cpu_supports("sse2") != 0;
+	bool avx2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+
+	if (avx2)
+		return INTRF_SIMD_AVX2;
+	if (sse2)
+		return INTRF_SIMD_SSE2;
+	return INTRF_SIMD_SCALAR;
+}
+
+#else
+
+static intrf_simd_level DetectSimd()
+{
+	return INTRF_SIMD_SCALAR;
+}
+
+#endif
+
+#define INTRF_SET_KERNELS(_mix) \
+	kernels.mix[0][0] = _mix<true, true, false, false>; \
+	kernels.mix[0][1] = _mix<true, true, false, true>; \
+	kernels.mix[1][0] = _mix<true, true, true, false>; \
+	kernels.mix[1][1] = _mix<true, true, true, true>; \
+	kernels.gain[0][0] = _mix<true, false, false, false>; \
+	kernels.gain[0][1] = _mix<true, false, false, true>; \
+	kernels.gain[1][0] = _mix<true, false, true, false>; \
+	kernels.gain[1][1] = _mix<true, false, true, true>; \
+	kernels.noise[0] = _mix<false, true, false, false>; \
+	kernels.noise[1] = _mix<false, true, false, true>
+
+#define INTRF_SET_BANK_KERNELS(_bank) \
+	kernels.bank[0][0] = _bank<true, false, false>; \
+	kernels.bank[0][1] = _bank<true, false, true>; \
+	kernels.bank[1][0] = _bank<true, true, false>; \
+	kernels.bank[1][1] = _bank<true, true, true>; \
+	kernels.bank_noise[0] = _bank<false, false, false>; \
+	kernels.bank_noise[1] = _bank<false, false, true>
+
+//Once per process, a System that is already mixing keeps reading the table
+static bool KernelsSelect()
+{
+	intrf_simd_level level = DetectSimd();
+
+	const char *cap = getenv("INTRF_SIMD");
+	if (cap)
+	{
+		intrf_simd_level limit = INTRF_SIMD_AVX2;
+		if (strcmp(cap, "scalar") == 0)
+			limit = INTRF_SIMD_SCALAR;
+		else if (strcmp(cap, "sse2") == 0)
+			limit = INTRF_SIMD_SSE2;
+		if (limit < level)
+			level = limit;
+	}
+
+	kernels.level = level;
+	INTRF_SET_KERNELS(MixScalar);
+	INTRF_SET_BANK_KERNELS(BankScalar);
+	kernels.batch = BatchScalar;
+#if INTRF_X86
+	if (level == INTRF_SIMD_AVX2)
+	{
+		INTRF_SET_KERNELS(MixAVX2);
+		INTRF_SET_BANK_KERNELS(BankAVX2);
+		kernels.batch = BatchAVX2;
+	}
+	else if (level == INTRF_SIMD_SSE2)
+	{
+		INTRF_SET_KERNELS(MixSSE2);
+		INTRF_SET_BANK_KERNELS(BankSSE2);
+		kernels.batch = BatchSSE2;
+	}
+#endif
+	return true;
+}
+
+void KernelsInit()
+{
+	static const bool selected = KernelsSelect();
+	(void)selected;
+}
+
+const char* KernelsName(intrf_simd_level level)
+{
+	switch (level)
+	{
+		case INTRF_SIMD_SSE2:
+			return "sse2";
+		case INTRF_SIMD_AVX2:
+			return "avx2";
+		default:
+			return "scalar";
+	}
+}
@@ -0,0 +1,147 @@
+#ifndef INTRF_DSP_H
+#define INTRF_DSP_H
+
+/*==========================================
+intRference DSP building blocks: random
+generator and the SIMD mixing kernels
+===========================================*/
+
+#define INTRF_RNG_LANES 8
+
+/*
+    Per instance xorshift32 generator. Lanes are independent streams so a block of noise steps all of them in one
+    vector register; RngNext draws single values from the first lane.
+*/
+typedef struct
+{
+	unsigned int lane[INTRF_RNG_LANES];
+} intrf_rng;
+
+void RngSeed(intrf_rng *rng, unsigned int seed);
+unsigned int RngNextInt(intrf_rng *rng);
+float RngNext(intrf_rng *rng);
+void RngFill(intrf_rng *rng, float *out, unsigned int count);
+
+/*
+	Jump ahead. A xorshift step is linear over GF(2), so n steps of a lane are one 32 x 32 bit matrix: RngJump moves
+	every lane n draws on in at most 32 matrix products, without generating the draws in between. A stream can be
+	split into disjoint substreams by jumping a copy to each one's start; intrf_rng_jump keeps a jump that is
+	applied over and over, such as one block's worth of draws.
+*/
+typedef struct
+{
+	unsigned int column[32];		//Image of each state bit
+} intrf_rng_jump;
+
+void RngJumpMake(intrf_rng_jump *jump, unsigned long long steps);
+void RngJumpApply(intrf_rng *rng, const intrf_rng_jump *jump);
+void RngJump(intrf_rng *rng, unsigned long long steps);
+
+/*
+	Shared noise bank: one read only table of uniform values in [-1, 1), generated once and identical for every
+	instance. Instances read windows of it at random offsets instead of stepping their own generator, which keeps the
+	noise down to a load and a multiply and the memory constant however many instances play.
+*/
+#define INTRF_NOISE_BANK_SIZE 65536
+
+void NoiseBankInit();
+const float* NoiseBank();
+
+/*
+	Flush to zero and denormals are zero around the plugin's own processing. Recursive filter memory decays into
+	subnormals once its input goes quiet, and x86 pays ten to a hundred times per operation on them. The mode the
+	mixer thread had is restored on the way out; on other targets (and x87 code) these do nothing.
+*/
+typedef struct
+{
+	unsigned long long saved;
+} intrf_fp_mode;
+
+void DenormalsDisable(intrf_fp_mode *mode);
+void DenormalsRestore(const intrf_fp_mode *mode);
+
+enum intrf_simd_level
+{
+	INTRF_SIMD_SCALAR,
+	INTRF_SIMD_SSE2,
+	INTRF_SIMD_AVX2
+};
+
+//Per call gains, each one ramps linearly over the elements of the call: gain + step * i
+typedef struct
+{
+	float voice;
+	float voice_step;
+	float noise;
+	float noise_step;
+} intrf_mix_gains;
+
+/*
+	out[i] = voice[i] * voice gain * mask[i] + noise * noise gain, noise drawn from rng in groups of INTRF_RNG_LANES.
+	Each implementation is specialized on whether mask and meter are used (see intrf_kernels::mix), the unused
+	pointers may be null. voice may alias outbuffer. Every implementation is bit identical to the scalar one.
+*/
+typedef void (*intrf_mix_func)(intrf_rng *rng, const float *voice, const float *mask, float *outbuffer, float *meter, unsigned int count, const intrf_mix_gains *gains);
+
+/*
+	Many voices processed in one pass, structure of arrays with one lane per voice channel. Lanes are tiled in groups
+	of INTRF_RNG_LANES so a group's block is contiguous: frame t of lane l is at
+	[(l / INTRF_RNG_LANES) * frames * INTRF_RNG_LANES + t * INTRF_RNG_LANES + l % INTRF_RNG_LANES].
+	Per lane, across the frames of the block, a trapezoidal state variable filter with integrator states buf0, buf1:
+		v3 = input - buf1, v1 = a1 * buf0 + a2 * v3, v2 = buf1 + a2 * buf0 + a3 * v3
+		buf0 = 2 * v1 - buf0, buf1 = 2 * v2 - buf1
+		out = (tap_input * input + tap_band * v1 + tap_low * v2) * (voice + voice_step * t) * mask
+		    + noise * (noise + noise_step * t)
+	The taps pick the filter response, the coefficients ramp by their step per frame. Groups of INTRF_RNG_LANES lanes
+	without an active lane are skipped.
+*/
+typedef struct
+{
+	unsigned int lanes;			//Capacity, a multiple of INTRF_RNG_LANES
+	unsigned int frames;
+	float *input;
+	float *mask;
+	float *output;
+	unsigned char *active;
+	unsigned int *rng;
+	float *buf0;
+	float *buf1;
+	float *a1;
+	float *a2;
+	float *a3;
+	float *a1_step;
+	float *a2_step;
+	float *a3_step;
+	float *tap_input;
+	float *tap_band;
+	float *tap_low;
+	float *voice;
+	float *voice_step;
+	float *noise;
+	float *noise_step;
+} intrf_batch_lanes;
+
+//The mix kernels with noise[i] in place of the generator, noise holds count values
+typedef void (*intrf_bank_func)(const float *noise, const float *voice, const float *mask, float *outbuffer, float *meter, unsigned int count, const intrf_mix_gains *gains);
+
+//Runs the first count lanes, count a multiple of INTRF_RNG_LANES
+typedef void (*intrf_batch_func)(const intrf_batch_lanes *batch, unsigned int count);
+
+typedef struct
+{
+	intrf_simd_level level;
+	intrf_mix_func mix[2][2];		// [mask used][meter used]
+	intrf_mix_func gain[2][2];		// Same without noise: out = voice * voice_gain * mask, rng untouched
+	intrf_mix_func noise[2];		// [meter used], voice lost: out = noise * noise_gain, voice and mask unused
+	intrf_bank_func bank[2][2];		// mix reading the noise bank, [mask used][meter used]
+	intrf_bank_func bank_noise[2];	// noise reading the noise bank, [meter used]
+	intrf_batch_func batch;
+} intrf_kernels;
+
+extern intrf_kernels kernels;
+
+//Picks the widest instruction set the CPU supports, on the first call only. INTRF_SIMD=scalar|sse2|avx2 in the environment caps it
+void KernelsInit();
+const char* KernelsName(intrf_simd_level level);
+
+#endif
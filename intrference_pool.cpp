@@ -0,0 +1,194 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "intrference_pool.h"
+#include <stdlib.h>
+#include <string.h>
+#include <mutex>
+
+#define INTRF_POOL_CLASSES    16			//Distinct block sizes, instances only ever ask for a handful
+#define INTRF_POOL_SLAB_BYTES (256 * 1024)
+#define INTRF_POOL_SLAB_MAX   64			//Blocks per slab
+
+/*
+	Every block is preceded by one aligned header line so the payload stays aligned. Blocks from a size class go back
+	to their free list, blocks that found no class are single allocations freed right away.
+*/
+typedef struct intrf_pool_block
+{
+	struct intrf_pool_block *next;
+	int sizeclass;					//-1 for a single allocation
+	void *raw;						//Single allocations only
+	FMOD_DSP_FREE_FUNC release;
+} intrf_pool_block;
+
+typedef struct intrf_pool_slab
+{
+	struct intrf_pool_slab *next;
+	void *raw;
+	FMOD_DSP_FREE_FUNC release;
+} intrf_pool_slab;
+
+typedef struct
+{
+	size_t size;					//Payload bytes, multiple of INTRF_POOL_ALIGN
+	intrf_pool_block *free;
+} intrf_pool_class;
+
+static struct
+{
+	std::mutex lock;
+	intrf_pool_class classes[INTRF_POOL_CLASSES];
+	int numclasses;
+	intrf_pool_slab *slabs;
+	int registrations;
+	int live;
+} pool;
+
+static void* PoolAlign(void *raw, size_t offset)
+{
+	size_t address = ((size_t)raw + offset + INTRF_POOL_ALIGN - 1) & ~(size_t)(INTRF_POOL_ALIGN - 1);
+	return (void *)address;
+}
+
+static void* PoolRawAlloc(FMOD_DSP_STATE *dsp_state, size_t size, FMOD_DSP_FREE_FUNC *release)
+{
+	if (dsp_state && dsp_state->functions && dsp_state->functions->alloc && dsp_state->functions->free)
+	{
+		*release = dsp_state->functions->free;
+		return dsp_state->functions->alloc((unsigned int)size, FMOD_MEMORY_NORMAL, __FILE__);
+	}
+	*release = 0;
+	return malloc(size);
+}
+
+static void PoolRawFree(void *raw, FMOD_DSP_FREE_FUNC release)
+{
+	if (release)
+		release(raw, FMOD_MEMORY_NORMAL, __FILE__);
+	else
+		free(raw);
+}
+
+//Carves a new slab into blocks of the class, called with the lock held
+static bool PoolGrow(FMOD_DSP_STATE *dsp_state, int sizeclass)
+{
+	size_t stride = INTRF_POOL_ALIGN + pool.classes[sizeclass].size;
+	size_t count = INTRF_POOL_SLAB_BYTES / stride;
+	if (count < 1)
+		count = 1;
+	if (count > INTRF_POOL_SLAB_MAX)
+		count = INTRF_POOL_SLAB_MAX;
+
+	FMOD_DSP_FREE_FUNC release;
+	void *raw = PoolRawAlloc(dsp_state, INTRF_POOL_ALIGN * 2 + stride * count, &release);
+	if (!raw)
+		return false;
+
+	intrf_pool_slab *slab = (intrf_pool_slab *)PoolAlign(raw, 0);
+	slab->raw = raw;
+	slab->release = release;
+	slab->next = pool.slabs;
+	pool.slabs = slab;
+
+	char *first = (char *)slab + INTRF_POOL_ALIGN;
+	for (size_t i = 0; i < count; i++)
+	{
+		intrf_pool_block *block = (intrf_pool_block *)(first + i * stride);
+		block->sizeclass = sizeclass;
+		block->next = pool.classes[sizeclass].free;
+		pool.classes[sizeclass].free = block;
+	}
+	return true;
+}
+
+void* PoolAlloc(FMOD_DSP_STATE *dsp_state, size_t size)
+{
+	size = (size + INTRF_POOL_ALIGN - 1) & ~(size_t)(INTRF_POOL_ALIGN - 1);
+
+	std::lock_guard<std::mutex> guard(pool.lock);
+
+	int sizeclass = -1;
+	for (int i = 0; i < pool.numclasses && sizeclass < 0; i++)
+	{
+		if (pool.classes[i].size == size)
+			sizeclass = i;
+	}
+	if (sizeclass < 0 && pool.numclasses < INTRF_POOL_CLASSES)
+	{
+		sizeclass = pool.numclasses++;
+		pool.classes[sizeclass].size = size;
+		pool.classes[sizeclass].free = 0;
+	}
+
+	intrf_pool_block *block;
+	if (sizeclass >= 0)
+	{
+		if (!pool.classes[sizeclass].free && !PoolGrow(dsp_state, sizeclass))
+			return 0;
+		block = pool.classes[sizeclass].free;
+		pool.classes[sizeclass].free = block->next;
+	}
+	else
+	{
+		FMOD_DSP_FREE_FUNC release;
+		void *raw = PoolRawAlloc(dsp_state, INTRF_POOL_ALIGN * 2 + size, &release);
+		if (!raw)
+			return 0;
+		block = (intrf_pool_block *)PoolAlign(raw, 0);
+		block->sizeclass = -1;
+		block->raw = raw;
+		block->release = release;
+	}
+
+	pool.live++;
+	void *ptr = (char *)block + INTRF_POOL_ALIGN;
+	memset(ptr, 0, size);
+	return ptr;
+}
+
+//Hands every slab back once no system is registered and no block is out, called with the lock held
+static void PoolTrim()
+{
+	if (pool.registrations > 0 || pool.live > 0)
+		return;
+
+	while (pool.slabs)
+	{
+		intrf_pool_slab *slab = pool.slabs;
+		pool.slabs = slab->next;
+		PoolRawFree(slab->raw, slab->release);
+	}
+	pool.numclasses = 0;
+}
+
+void PoolFree(void *ptr)
+{
+	if (!ptr)
+		return;
+
+	intrf_pool_block *block = (intrf_pool_block *)((char *)ptr - INTRF_POOL_ALIGN);
+
+	std::lock_guard<std::mutex> guard(pool.lock);
+	pool.live--;
+	if (block->sizeclass < 0)
+		PoolRawFree(block->raw, block->release);
+	else
+	{
+		block->next = pool.classes[block->sizeclass].free;
+		pool.classes[block->sizeclass].free = block;
+	}
+	PoolTrim();
+}
+
+void PoolRegister()
+{
+	std::lock_guard<std::mutex> guard(pool.lock);
+	pool.registrations++;
+}
+
+void PoolDeregister()
+{
+	std::lock_guard<std::mutex> guard(pool.lock);
+	pool.registrations--;
+	PoolTrim();
+}
@@ -0,0 +1,31 @@
+#ifndef INTRF_POOL_H
+#define INTRF_POOL_H
+
+/*==========================================
+intRference instance pool: fixed size
+blocks carved from slabs, reused on release
+===========================================*/
+
+#include "fmod.hpp"
+#include <stddef.h>
+
+#define INTRF_CACHE_LINE 64
+#define INTRF_POOL_ALIGN INTRF_CACHE_LINE
+
+/*
+	Returns zeroed memory aligned to INTRF_POOL_ALIGN. Blocks of a size seen before come off a free list, new slabs
+	are taken from dsp_state->functions->alloc (malloc when the host has none). Create, release and scratch resizes
+	run on API threads, never on the mixer.
+*/
+void* PoolAlloc(FMOD_DSP_STATE *dsp_state, size_t size);
+void PoolFree(void *ptr);
+
+/*
+	Counted per system registration. The slabs go back to FMOD once the last system is deregistered and the last
+	block is freed, whichever comes second: instances still live at the last deregistration keep them until they
+	are released.
+*/
+void PoolRegister();
+void PoolDeregister();
+
+#endif
@@ -0,0 +1,80 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "intrference_timing.h"
+#include <string.h>
+#include <chrono>
+
+void TimingInit(intrf_timing_buffer *timing)
+{
+	TimingClear(timing);
+	for (int i = 0; i < 3; i++)
+		timing->slot[i].timing = timing->current;
+	timing->read = timing->current;
+	TripleInit(&timing->triple);
+}
+
+unsigned long long TimingNow()
+{
+	return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void TimingClear(intrf_timing_buffer *timing)
+{
+	memset(&timing->current, 0, sizeof(timing->current));
+	timing->current.version = INTRF_TIMING_VERSION;
+}
+
+static int TimingBucket(unsigned long long ns)
+{
+	int bucket = 0;
+	while (ns > 1 && bucket < INTRF_TIMING_BUCKETS - 1)
+	{
+		ns >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
+void TimingRecord(intrf_timing_buffer *timing, unsigned long long elapsed_ns, unsigned long long deadline_ns, unsigned int samples)
+{
+	intrf_timing *current = &timing->current;
+	if (current->calls == 0 || elapsed_ns < current->min_ns)
+		current->min_ns = elapsed_ns;
+	if (elapsed_ns > current->max_ns)
+		current->max_ns = elapsed_ns;
+	current->calls++;
+	current->samples += samples;
+	current->total_ns += elapsed_ns;
+	current->last_ns = elapsed_ns;
+	current->overruns += elapsed_ns > deadline_ns ? 1 : 0;
+	current->histogram[TimingBucket(elapsed_ns)]++;
+
+	timing->slot[timing->triple.back].timing = *current;
+	TriplePublish(&timing->triple);
+}
+
+//Upper edge of the bucket holding the given share of the calls
+static unsigned long long TimingPercentile(const intrf_timing *timing, unsigned int percent)
+{
+	unsigned long long wanted = ((unsigned long long)timing->calls * percent + 99) / 100;
+	unsigned long long seen = 0;
+	for (int bucket = 0; bucket < INTRF_TIMING_BUCKETS; bucket++)
+	{
+		seen += timing->histogram[bucket];
+		if (seen >= wanted && seen > 0)
+		{
+			unsigned long long edge = 2ull << bucket;
+			return bucket == INTRF_TIMING_BUCKETS - 1 || edge > timing->max_ns ? timing->max_ns : edge;
+		}
+	}
+	return 0;
+}
+
+const intrf_timing* TimingRead(intrf_timing_buffer *timing)
+{
+	timing->read = timing->slot[TripleAcquire(&timing->triple)].timing;
+	timing->read.p50_ns = TimingPercentile(&timing->read, 50);
+	timing->read.p90_ns = TimingPercentile(&timing->read, 90);
+	timing->read.p99_ns = TimingPercentile(&timing->read, 99);
+	return &timing->read;
+}
@@ -0,0 +1,61 @@
+#ifndef INTRF_TIMING_H
+#define INTRF_TIMING_H
+
+/*==========================================
+intRference timing: per callback cost of
+an instance, read through the Timing data
+parameter
+===========================================*/
+
+#include "intrference_pool.h"
+#include "intrference_triple.h"
+
+#define INTRF_TIMING_VERSION 1
+#define INTRF_TIMING_BUCKETS 32			//Bucket i counts calls of [2^i, 2^(i+1)) ns, the last one everything above
+
+/*
+	What the Timing parameter hands out, layout fixed by version. Counts run from the moment Profiling was turned on.
+	Percentiles come from the histogram and are the upper edge of the bucket they fall in. A call overruns when it
+	takes longer than the audio it produced lasts.
+*/
+typedef struct
+{
+	unsigned int version;
+	unsigned int calls;
+	unsigned long long samples;				//Samples written, frames times channels
+	unsigned long long total_ns;
+	unsigned long long min_ns;
+	unsigned long long max_ns;
+	unsigned long long last_ns;
+	unsigned long long p50_ns;
+	unsigned long long p90_ns;
+	unsigned long long p99_ns;
+	unsigned int overruns;
+	unsigned int histogram[INTRF_TIMING_BUCKETS];
+} intrf_timing;
+
+typedef struct alignas(INTRF_CACHE_LINE)
+{
+	intrf_timing timing;
+} intrf_timing_slot;
+
+//The mixer accumulates into current and publishes a copy after every call, a read takes the newest one
+typedef struct
+{
+	alignas(INTRF_CACHE_LINE) intrf_timing current;		//Mixer side
+	intrf_timing_slot slot[3];
+	intrf_triple triple;								//Mixer writes, API reads
+	intrf_timing read;									//What the data parameter points at
+} intrf_timing_buffer;
+
+void TimingInit(intrf_timing_buffer *timing);
+
+//Mixer side
+unsigned long long TimingNow();
+void TimingClear(intrf_timing_buffer *timing);
+void TimingRecord(intrf_timing_buffer *timing, unsigned long long elapsed_ns, unsigned long long deadline_ns, unsigned int samples);
+
+//API side, fills in the percentiles of the newest published copy
+const intrf_timing* TimingRead(intrf_timing_buffer *timing);
+
+#endif
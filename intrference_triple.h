@@ -0,0 +1,49 @@
+#ifndef INTRF_TRIPLE_H
+#define INTRF_TRIPLE_H
+
+/*==========================================
+intRference triple buffer: hands the newest
+of three slots from one writer to one reader
+===========================================*/
+
+#include "intrference_pool.h"
+#include <atomic>
+
+#define INTRF_TRIPLE_DIRTY 4			//Set in middle while it holds a slot the reader has not taken yet
+
+/*
+	Only the slot indices, the owner keeps the three slots. The writer fills its back slot and publishes it, taking
+	whatever middle held as its new back; the reader swaps middle with its front slot when something new was
+	published. Neither side ever waits, and each side's slot stays untouched by the other until it publishes or
+	acquires again. Used for the parameters (setters to mixer), the meter and the timing (mixer to API).
+*/
+typedef struct
+{
+	int back;											//Writer side
+	alignas(INTRF_CACHE_LINE) std::atomic<int> middle;
+	int front;											//Reader side, which touches middle anyway
+} intrf_triple;
+
+inline void TripleInit(intrf_triple *triple)
+{
+	triple->back = 0;
+	triple->front = 1;
+	triple->middle.store(2);
+}
+
+//Writer side: publishes the back slot, returns the slot to fill next
+inline int TriplePublish(intrf_triple *triple)
+{
+	triple->back = triple->middle.exchange(triple->back | INTRF_TRIPLE_DIRTY, std::memory_order_acq_rel) & ~INTRF_TRIPLE_DIRTY;
+	return triple->back;
+}
+
+//Reader side: the newest published slot
+inline int TripleAcquire(intrf_triple *triple)
+{
+	if (triple->middle.load(std::memory_order_relaxed) & INTRF_TRIPLE_DIRTY)
+		triple->front = triple->middle.exchange(triple->front, std::memory_order_acq_rel) & ~INTRF_TRIPLE_DIRTY;
+	return triple->front;
+}
+
+#endif
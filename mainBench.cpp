@@ -0,0 +1,319 @@
+/*==============================================================================
+intRference read callback benchmark
+
+Runs IntrfReadCallback through the headless host over a matrix of block sizes,
+channel counts, loss modes and filter modes and reports ns/sample and how many
+realtime voices one core could sustain. Results are written as JSON, one case
+per line, and can be compared against an earlier run.
+
+With -voices every case runs that many instances as units of one system, one
+Host_Mix per block, and -batch turns the Batch parameter on for all of them so
+the system's batch pass processes them together. ns/sample then counts the
+samples of every voice.
+
+    intrference_bench [-o results.json] [-baseline old.json] [-threshold 10]
+                      [-only substring] [-seconds 1] [-quick]
+                      [-voices n] [-batch]
+
+With -baseline the exit code is 2 when any case got slower than the threshold
+(in percent). Build:
+    g++ -O2 -I$FMOD_INC intrference.cpp intrference_dsp.cpp intrference_pool.cpp intrference_batch.cpp intrference_timing.cpp host.cpp mainBench.cpp -o intrference_bench
+==============================================================================*/
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "host.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_MAX_CASES 1024
+#define BENCH_REPEATS   5
+
+enum Bench_Input
+{
+    BENCH_INPUT_VOICE,
+    BENCH_INPUT_TAIL,               // Voice for the first quarter, then silence the filters decay in
+};
+
+typedef struct
+{
+    Host_Case    info;
+    Bench_Input  input;
+    int          voices;             // Units in the system
+    bool         batch;
+
+    double       ns_per_sample;
+    double       voices_per_core;
+    double       baseline;           // ns/sample from the baseline file, 0 when not found
+} Bench_Case;
+
+static const unsigned int gBlockSizes[] = { 64, 128, 256, 512, 1024, 2048, 4096 };
+static const int          gChannels[] = { 1, 2, 6, 8 };
+
+static const char *InputName(Bench_Input input)
+{
+    switch (input)
+    {
+        case BENCH_INPUT_VOICE:     return "voice";
+        case BENCH_INPUT_TAIL:      return "tail";
+        default:                    return "unknown";
+    }
+}
+
+static void FillInput(Host_Wav *wav, Bench_Input input)
+{
+    switch (input)
+    {
+        case BENCH_INPUT_TAIL:
+        {
+            Host_GenerateVoice(wav, 1);
+            size_t signal = (size_t)(wav->frames / 4) * wav->channels;
+            memset(wav->samples + signal, 0, ((size_t)wav->frames * wav->channels - signal) * sizeof(float));
+            break;
+        }
+        case BENCH_INPUT_VOICE:
+        default:
+            Host_GenerateVoice(wav, 1);
+            break;
+    }
+}
+
+static void AddCase(Bench_Case *cases, int *count, unsigned int blocksize, int channels, int lose_type, int filter_type, Bench_Input input, int voices, bool batch)
+{
+    if (*count >= BENCH_MAX_CASES)
+        return;
+
+    Bench_Case *c = &cases[(*count)++];
+    memset(c, 0, sizeof(Bench_Case));
+    c->input = input;
+    c->voices = voices;
+    c->batch = batch;
+
+    char suffix[48];
+    sprintf(suffix, "/%s", InputName(input));
+    if (voices > 1 || batch)
+        sprintf(suffix + strlen(suffix), "/v%d%s", voices, batch ? "/batch" : "");
+    Host_InitCase(&c->info, blocksize, channels, lose_type, filter_type, suffix);
+}
+
+// Every stage active at a representative setting
+static void SetParameters(Host_Instance *host, const Bench_Case *c)
+{
+    Host_SetParameter(host, Host_FindParameter(host, "Voice Shatter"), 50.0f);
+    Host_SetParameter(host, Host_FindParameter(host, "Noise Volume"), 50.0f);
+    Host_SetParameter(host, Host_FindParameter(host, "Noise Shatter"), 50.0f);
+    Host_SetParameter(host, Host_FindParameter(host, "Lose Rate"), 50.0f);
+    Host_SetParameter(host, Host_FindParameter(host, "Voice Cutoff"), 1000.0f);
+    Host_SetParameter(host, Host_FindParameter(host, "Batch"), c->batch ? 1.0f : 0.0f);
+    Host_ApplyCase(host, &c->info);
+}
+
+// One pass over the input, every voice reads the same input and the first one writes the output
+static bool RenderPass(Host_Instance **hosts, int voices, const Host_Wav *input, Host_Wav *output, float **inbuffers, float **outbuffers)
+{
+    unsigned int blocksize = hosts[0]->blocksize;
+    for (unsigned int frame = 0; frame < input->frames; frame += blocksize)
+    {
+        size_t offset = (size_t)frame * input->channels;
+        for (int v = 0; v < voices; v++)
+            inbuffers[v] = input->samples + offset;
+        outbuffers[0] = output->samples + offset;
+        if (Host_Mix(hosts, voices, inbuffers, outbuffers, blocksize) != FMOD_OK)
+            return false;
+    }
+    return true;
+}
+
+static bool RunCase(Bench_Case *c, float seconds)
+{
+    const int samplerate = 48000;
+    unsigned int frames = (unsigned int)(seconds * samplerate);
+    frames -= frames % c->info.blocksize;
+    if (frames == 0)
+        frames = c->info.blocksize;
+
+    Host_Wav input, output;
+    if (Host_AllocWav(&input, frames, c->info.channels, samplerate) != FMOD_OK || Host_AllocWav(&output, frames, c->info.channels, samplerate) != FMOD_OK)
+        return false;
+    FillInput(&input, c->input);
+
+    // The other voices write to one scratch block each, only the first one keeps its output
+    Host_Instance *units = (Host_Instance *)calloc(c->voices, sizeof(Host_Instance));
+    Host_Instance **hosts = (Host_Instance **)calloc(c->voices, sizeof(Host_Instance *));
+    float **inbuffers = (float **)calloc(c->voices, sizeof(float *));
+    float **outbuffers = (float **)calloc(c->voices, sizeof(float *));
+    float *scratch = (float *)calloc((size_t)c->voices * c->info.blocksize * c->info.channels, sizeof(float));
+    bool ok = units && hosts && inbuffers && outbuffers && scratch;
+
+    int created = 0;
+    for (; ok && created < c->voices; created++)
+    {
+        hosts[created] = &units[created];
+        outbuffers[created] = scratch + (size_t)created * c->info.blocksize * c->info.channels;
+        FMOD_RESULT result = created ? Host_CreateInSystem(&units[created], &units[0], c->info.channels) : Host_Create(&units[0], c->info.blocksize, samplerate, c->info.channels);
+        if (result != FMOD_OK)
+            ok = false;
+        else
+            SetParameters(&units[created], c);
+    }
+
+    // Warm up caches and branch predictors, then keep the fastest of a few passes
+    ok = ok && RenderPass(hosts, c->voices, &input, &output, inbuffers, outbuffers);
+    unsigned long long best = ~0ull;
+    for (int repeat = 0; ok && repeat < BENCH_REPEATS; repeat++)
+    {
+        unsigned long long start = Host_Clock();
+        ok = RenderPass(hosts, c->voices, &input, &output, inbuffers, outbuffers);
+        unsigned long long elapsed = Host_Clock() - start;
+        if (elapsed < best)
+            best = elapsed;
+    }
+
+    if (best == 0)
+        best = 1;
+    c->ns_per_sample = (double)best / ((double)frames * c->info.channels * c->voices);
+    c->voices_per_core = c->voices * ((double)frames / samplerate) / (best / 1e9);
+
+    // Units before the instance that owns the system
+    for (int v = (ok ? c->voices : created) - 1; v >= 0; v--)
+        Host_Release(&units[v]);
+    free(units);
+    free(hosts);
+    free(inbuffers);
+    free(outbuffers);
+    free(scratch);
+    Host_FreeWav(&input);
+    Host_FreeWav(&output);
+    return ok;
+}
+
+static void BaselineFound(Host_Case *info, const char *line)
+{
+    const char *value = Host_IndexField(line, "ns_per_sample");
+    if (value)
+        ((Bench_Case *)info)->baseline = atof(value);
+}
+
+static void LoadBaseline(const char *path, Bench_Case *cases, int count)
+{
+    if (!Host_ScanIndex(path, &cases[0].info, count, sizeof(Bench_Case), BaselineFound))
+        fprintf(stderr, "could not open baseline %s\n", path);
+}
+
+int main(int argc, char **argv)
+{
+    const char *outpath = 0;
+    const char *baselinepath = 0;
+    const char *only = 0;
+    double      threshold = 10.0;
+    float       seconds = 1.0f;
+    bool        quick = false;
+    int         voices = 1;
+    bool        batch = false;
+    bool        usage = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-quick") == 0)
+            quick = true;
+        else if (strcmp(argv[i], "-batch") == 0)
+            batch = true;
+        else if (i + 1 < argc && strcmp(argv[i], "-voices") == 0)
+            voices = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "-o") == 0)
+            outpath = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "-baseline") == 0)
+            baselinepath = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "-threshold") == 0)
+            threshold = atof(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "-only") == 0)
+            only = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "-seconds") == 0)
+            seconds = (float)atof(argv[++i]);
+        else
+            usage = true;
+    }
+    if (usage || voices < 1)
+    {
+        fprintf(stderr, "usage: intrference_bench [-o results.json] [-baseline old.json] [-threshold pct] [-only substring] [-seconds s] [-quick] [-voices n] [-batch]\n");
+        return 1;
+    }
+
+    static Bench_Case cases[BENCH_MAX_CASES];
+    int count = 0;
+
+    for (size_t b = 0; b < sizeof(gBlockSizes) / sizeof(gBlockSizes[0]); b++)
+    {
+        if (quick && gBlockSizes[b] != 256 && gBlockSizes[b] != 1024)
+            continue;
+
+        for (size_t c = 0; c < sizeof(gChannels) / sizeof(gChannels[0]); c++)
+        {
+            for (int lose_type = -1; lose_type <= 3; lose_type++)
+            {
+                for (int filter_type = -1; filter_type <= 2; filter_type++)
+                    AddCase(cases, &count, gBlockSizes[b], gChannels[c], lose_type, filter_type, BENCH_INPUT_VOICE, voices, batch);
+            }
+
+            //Filters ringing out into silence, where subnormal filter memory used to show up
+            for (int filter_type = 0; filter_type <= 2; filter_type++)
+                AddCase(cases, &count, gBlockSizes[b], gChannels[c], -1, filter_type, BENCH_INPUT_TAIL, voices, batch);
+        }
+    }
+
+    if (only)
+    {
+        int kept = 0;
+        for (int i = 0; i < count; i++)
+        {
+            if (strstr(cases[i].info.name, only))
+                cases[kept++] = cases[i];
+        }
+        count = kept;
+    }
+
+    if (baselinepath)
+        LoadBaseline(baselinepath, cases, count);
+
+    FILE *out = outpath ? fopen(outpath, "w") : stdout;
+    if (!out)
+    {
+        fprintf(stderr, "could not open %s\n", outpath);
+        return 1;
+    }
+
+    int regressions = 0;
+    fprintf(out, "{\n\"cases\": [\n");
+    for (int i = 0; i < count; i++)
+    {
+        Bench_Case *c = &cases[i];
+        if (!RunCase(c, seconds))
+        {
+            fprintf(stderr, "%s: failed\n", c->info.name);
+            return 1;
+        }
+
+        double change = c->baseline > 0 ? (c->ns_per_sample / c->baseline - 1.0) * 100.0 : 0.0;
+        bool regressed = c->baseline > 0 && change > threshold;
+        regressions += regressed ? 1 : 0;
+
+        fprintf(out, "{\"name\": \"%s\", \"blocksize\": %u, \"channels\": %d, \"lose_type\": %d, \"filter_type\": %d, \"input\": \"%s\", \"voices\": %d, \"batch\": %s, \"ns_per_sample\": %.4f, \"voices_per_core\": %.1f",
+            c->info.name, c->info.blocksize, c->info.channels, c->info.lose_type, c->info.filter_type, InputName(c->input), c->voices, c->batch ? "true" : "false", c->ns_per_sample, c->voices_per_core);
+        if (c->baseline > 0)
+            fprintf(out, ", \"baseline_ns_per_sample\": %.4f, \"change_percent\": %.2f, \"regressed\": %s", c->baseline, change, regressed ? "true" : "false");
+        fprintf(out, "}%s\n", i + 1 < count ? "," : "");
+
+        if (outpath)
+            fprintf(stderr, "%-48s %8.3f ns/sample %10.0f voices/core%s\n", c->info.name, c->ns_per_sample, c->voices_per_core, regressed ? "  REGRESSED" : "");
+    }
+    fprintf(out, "],\n\"regressions\": %d\n}\n", regressions);
+
+    if (outpath)
+        fclose(out);
+
+    if (regressions)
+        fprintf(stderr, "%d case(s) slower than baseline by more than %.1f%%\n", regressions, threshold);
+
+    return regressions ? 2 : 0;
+}
@@ -0,0 +1,428 @@
+/*==============================================================================
+intRference golden output and performance check
+
+Renders fixed inputs with a fixed Seed through every lose type and filter
+type, a few channel layouts and the noise bank, batch, automation and filter
+tail cases, and a mono voice on a stereo mixer (speaker mode and input
+disagree, which a single host never shows), then compares each output with a stored reference and each
+timing with a stored baseline. Raw layouts wider than the 8 channels the
+plugin sizes its scratch for up front check that wide blocks are processed
+before the scratch catches up. Every case adds noise, so a block that comes
+out equal to its input passed through dry and fails the case.
+
+    intrference_golden -record dir [-only substring] [-seconds 1]
+    intrference_golden -check dir [-tolerance 1e-5] [-threshold 10]
+                       [-only substring] [-noperf]
+
+-record writes dir/<case>.wav and dir/golden.json (hash, ns/sample and the
+kernels used). -check renders the same cases again: outputs must match the
+references within the tolerance, bit for bit when both runs used the scalar
+kernels (INTRF_SIMD=scalar in the environment). Every case is rendered a few
+times with fresh instances and all passes have to agree. A case whose hash
+differs and has no WAV to compare against differs.
+
+golden/ holds the reference hashes for the default settings, recorded with
+the scalar kernels and without timings or WAVs:
+    intrference_golden -check golden -noperf
+Timings only mean something against a baseline recorded on the same machine.
+
+Exit code 2 when an output differs, 3 when the outputs match but a case got
+slower than the threshold (in percent). Build:
+    g++ -O2 -I$FMOD_INC intrference.cpp intrference_dsp.cpp intrference_pool.cpp intrference_batch.cpp intrference_timing.cpp host.cpp mainGolden.cpp -o intrference_golden
+==============================================================================*/
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "host.h"
+#include "intrference_dsp.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GOLDEN_MAX_CASES  256
+#define GOLDEN_REPEATS    3
+#define GOLDEN_BLOCKSIZE  512
+#define GOLDEN_SAMPLERATE 48000
+#define GOLDEN_SEED       1234
+
+enum Golden_Flags
+{
+    GOLDEN_BANK     = 1,            // Noise Bank on
+    GOLDEN_BATCH    = 2,            // Batch on
+    GOLDEN_AUTOMATE = 4,            // Parameters change halfway through
+    GOLDEN_TAIL     = 8,            // Voice for the first quarter, then silence
+    GOLDEN_STEREO   = 16,           // Unit in a stereo system, whatever its own channel count
+};
+
+typedef struct
+{
+    Host_Case    info;
+    int          flags;
+
+    unsigned long long hash;
+    double       ns_per_sample;
+
+    bool         found;              // Reference entry present
+    unsigned long long ref_hash;
+    double       ref_ns_per_sample;
+    char         ref_kernels[16];
+} Golden_Case;
+
+static void AddCase(Golden_Case *cases, int *count, int channels, int lose_type, int filter_type, int flags)
+{
+    if (*count >= GOLDEN_MAX_CASES)
+        return;
+
+    Golden_Case *c = &cases[(*count)++];
+    memset(c, 0, sizeof(Golden_Case));
+    c->flags = flags;
+
+    char suffix[48];
+    sprintf(suffix, "%s%s%s%s%s", flags & GOLDEN_BANK ? "/bank" : "", flags & GOLDEN_BATCH ? "/batch" : "",
+        flags & GOLDEN_AUTOMATE ? "/automate" : "", flags & GOLDEN_TAIL ? "/tail" : "", flags & GOLDEN_STEREO ? "/stereo-mixer" : "");
+    Host_InitCase(&c->info, GOLDEN_BLOCKSIZE, channels, lose_type, filter_type, suffix);
+}
+
+static void SetParameters(Host_Instance *host, const Golden_Case *c, bool second_half)
+{
+    Host_SetParameter(host, Host_FindParameter(host, "Voice Shatter"), second_half ? 80.0f : 50.0f);
+    Host_SetParameter(host, Host_FindParameter(host, "Noise Volume"), second_half ? 20.0f : 50.0f);
+    Host_SetParameter(host, Host_FindParameter(host, "Noise Shatter"), 50.0f);
+    Host_SetParameter(host, Host_FindParameter(host, "Lose Rate"), second_half ? 70.0f : 40.0f);
+    Host_SetParameter(host, Host_FindParameter(host, "Voice Cutoff"), second_half ? 4000.0f : 1000.0f);
+    Host_SetParameter(host, Host_FindParameter(host, "Filter Q"), second_half ? 6.0f : 2.0f);
+    Host_SetParameter(host, Host_FindParameter(host, "Packet Length"), 10.0f);
+    Host_SetParameter(host, Host_FindParameter(host, "Burst Length"), second_half ? 6.0f : 3.0f);
+    Host_SetParameter(host, Host_FindParameter(host, "Noise Bank"), c->flags & GOLDEN_BANK ? 1.0f : 0.0f);
+    Host_SetParameter(host, Host_FindParameter(host, "Batch"), c->flags & GOLDEN_BATCH ? 1.0f : 0.0f);
+    Host_ApplyCase(host, &c->info);
+}
+
+//One pass on a fresh instance, returns the nanoseconds spent in the plugin or 0 on failure
+static unsigned long long RenderCase(const Golden_Case *c, const Host_Wav *input, Host_Wav *output)
+{
+    Host_Instance host, mixer;
+    bool stereo = (c->flags & GOLDEN_STEREO) != 0;
+    if (stereo && Host_Create(&mixer, GOLDEN_BLOCKSIZE, input->samplerate, 2) != FMOD_OK)
+        return 0;
+    FMOD_RESULT created = stereo ? Host_CreateInSystem(&host, &mixer, input->channels) : Host_Create(&host, GOLDEN_BLOCKSIZE, input->samplerate, input->channels);
+    if (created != FMOD_OK)
+    {
+        if (stereo)
+            Host_Release(&mixer);
+        return 0;
+    }
+
+    Host_SetParameterInt(&host, Host_FindParameter(&host, "Seed"), GOLDEN_SEED);
+    SetParameters(&host, c, false);
+
+    unsigned int half = input->frames / 2;
+    half -= half % GOLDEN_BLOCKSIZE;
+    unsigned int first = c->flags & GOLDEN_AUTOMATE ? half : input->frames;
+    size_t offset = (size_t)first * input->channels;
+
+    unsigned long long start = Host_Clock();
+    bool ok = Host_Process(&host, input->samples, output->samples, first) == FMOD_OK;
+    if (ok && first < input->frames)
+    {
+        SetParameters(&host, c, true);
+        ok = Host_Process(&host, input->samples + offset, output->samples + offset, input->frames - first) == FMOD_OK;
+    }
+    unsigned long long elapsed = Host_Clock() - start;
+
+    Host_Release(&host);
+    if (stereo)
+        Host_Release(&mixer);
+    return ok ? (elapsed ? elapsed : 1) : 0;
+}
+
+static unsigned long long Hash(const Host_Wav *wav)
+{
+    const unsigned char *bytes = (const unsigned char *)wav->samples;
+    size_t size = (size_t)wav->frames * wav->channels * sizeof(float);
+
+    unsigned long long hash = 14695981039346656037ull;      // FNV-1a
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    return hash;
+}
+
+//Case names nest like paths, the WAV files sit side by side
+static void CasePath(char *path, size_t size, const char *dir, const Golden_Case *c)
+{
+    char file[sizeof(c->info.name)];
+    strcpy(file, c->info.name);
+    for (char *slash = strchr(file, '/'); slash; slash = strchr(slash, '/'))
+        *slash = '_';
+    snprintf(path, size, "%s/%s.wav", dir, file);
+}
+
+static void IndexFound(Host_Case *info, const char *line)
+{
+    Golden_Case *c = (Golden_Case *)info;
+    const char *hash = Host_IndexField(line, "hash");
+    const char *time = Host_IndexField(line, "ns_per_sample");
+    const char *used = Host_IndexField(line, "kernels");
+    if (!hash)
+        return;
+
+    c->found = true;
+    c->ref_hash = strtoull(hash, 0, 16);
+    c->ref_ns_per_sample = time ? atof(time) : 0.0;
+    if (used)
+        sscanf(used, "%15[^\"]", c->ref_kernels);
+}
+
+static bool LoadIndex(const char *dir, Golden_Case *cases, int count)
+{
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/golden.json", dir);
+    if (!Host_ScanIndex(path, &cases[0].info, count, sizeof(Golden_Case), IndexFound))
+    {
+        fprintf(stderr, "could not open %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+//Blocks of output that are a bit for bit copy of the input
+static int DryBlocks(const Host_Wav *input, const Host_Wav *output)
+{
+    int dry = 0;
+    size_t block = (size_t)GOLDEN_BLOCKSIZE * input->channels;
+    size_t count = (size_t)input->frames * input->channels;
+    for (size_t i = 0; i < count; i += block)
+    {
+        size_t size = count - i < block ? count - i : block;
+        dry += memcmp(input->samples + i, output->samples + i, size * sizeof(float)) == 0 ? 1 : 0;
+    }
+    return dry;
+}
+
+//Largest sample difference, or a negative value when the layouts differ
+static double Compare(const Host_Wav *a, const Host_Wav *b)
+{
+    if (a->frames != b->frames || a->channels != b->channels)
+        return -1.0;
+
+    double worst = 0.0;
+    size_t count = (size_t)a->frames * a->channels;
+    for (size_t i = 0; i < count; i++)
+    {
+        double diff = fabs((double)a->samples[i] - (double)b->samples[i]);
+        if (!(diff <= worst))
+            worst = diff;           // NaN sticks
+    }
+    return worst;
+}
+
+int main(int argc, char **argv)
+{
+    const char *recorddir = 0;
+    const char *checkdir = 0;
+    const char *only = 0;
+    double      tolerance = 1e-5;
+    double      threshold = 10.0;
+    float       seconds = 1.0f;
+    bool        perf = true;
+    bool        usage = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-noperf") == 0)
+            perf = false;
+        else if (i + 1 < argc && strcmp(argv[i], "-record") == 0)
+            recorddir = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "-check") == 0)
+            checkdir = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "-tolerance") == 0)
+            tolerance = atof(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "-threshold") == 0)
+            threshold = atof(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "-only") == 0)
+            only = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "-seconds") == 0)
+            seconds = (float)atof(argv[++i]);
+        else
+            usage = true;
+    }
+    if (usage || !recorddir == !checkdir)
+    {
+        fprintf(stderr, "usage: intrference_golden -record dir | -check dir [-tolerance t] [-threshold pct] [-only substring] [-seconds s] [-noperf]\n");
+        return 1;
+    }
+
+    static Golden_Case cases[GOLDEN_MAX_CASES];
+    int count = 0;
+
+    static const int channels[] = { 1, 2, 6 };
+    for (size_t c = 0; c < sizeof(channels) / sizeof(channels[0]); c++)
+    {
+        for (int lose_type = -1; lose_type <= 3; lose_type++)
+        {
+            for (int filter_type = -1; filter_type <= 2; filter_type++)
+                AddCase(cases, &count, channels[c], lose_type, filter_type, 0);
+        }
+    }
+    for (int lose_type = -1; lose_type <= 3; lose_type++)
+    {
+        AddCase(cases, &count, 2, lose_type, 0, GOLDEN_BANK);
+        AddCase(cases, &count, 2, lose_type, 0, GOLDEN_AUTOMATE);
+    }
+    static const int raw[] = { 9, 16 };
+    for (size_t c = 0; c < sizeof(raw) / sizeof(raw[0]); c++)
+    {
+        for (int lose_type = -1; lose_type <= 3; lose_type++)
+            AddCase(cases, &count, raw[c], lose_type, lose_type % 3, 0);
+        AddCase(cases, &count, raw[c], 3, 1, GOLDEN_AUTOMATE);
+    }
+    for (int filter_type = -1; filter_type <= 2; filter_type++)
+    {
+        AddCase(cases, &count, 2, 1, filter_type, GOLDEN_BATCH);
+        AddCase(cases, &count, 2, -1, filter_type, GOLDEN_AUTOMATE);
+        if (filter_type >= 0)
+            AddCase(cases, &count, 2, -1, filter_type, GOLDEN_TAIL);
+    }
+    //A mono voice on a stereo mixer: scratch and batch lanes start out sized for the speaker mode
+    AddCase(cases, &count, 1, 1, 1, GOLDEN_STEREO);
+    AddCase(cases, &count, 1, 1, 1, GOLDEN_STEREO | GOLDEN_BATCH | GOLDEN_AUTOMATE);
+    AddCase(cases, &count, 1, 1, 1, GOLDEN_BATCH | GOLDEN_AUTOMATE);
+
+    if (only)
+    {
+        int kept = 0;
+        for (int i = 0; i < count; i++)
+        {
+            if (strstr(cases[i].info.name, only))
+                cases[kept++] = cases[i];
+        }
+        count = kept;
+    }
+
+    if (checkdir && !LoadIndex(checkdir, cases, count))
+        return 1;
+
+    FILE *index = 0;
+    if (recorddir)
+    {
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/golden.json", recorddir);
+        index = fopen(path, "w");
+        if (!index)
+        {
+            fprintf(stderr, "could not create %s\n", path);
+            return 1;
+        }
+        fprintf(index, "{\n\"cases\": [\n");
+    }
+
+    unsigned int frames = (unsigned int)(seconds * GOLDEN_SAMPLERATE);
+    const char *kernelname = 0;
+    int mismatches = 0, regressions = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        Golden_Case *c = &cases[i];
+
+        Host_Wav input, output, pass;
+        if (Host_AllocWav(&input, frames, c->info.channels, GOLDEN_SAMPLERATE) != FMOD_OK || Host_AllocWav(&output, frames, c->info.channels, GOLDEN_SAMPLERATE) != FMOD_OK ||
+            Host_AllocWav(&pass, frames, c->info.channels, GOLDEN_SAMPLERATE) != FMOD_OK)
+        {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+        Host_GenerateVoice(&input, 1);
+        if (c->flags & GOLDEN_TAIL)
+        {
+            size_t signal = (size_t)(frames / 4) * c->info.channels;
+            memset(input.samples + signal, 0, ((size_t)frames * c->info.channels - signal) * sizeof(float));
+        }
+
+        // Fastest of the passes, every one of them has to produce the same samples
+        unsigned long long best = RenderCase(c, &input, &output);
+        bool deterministic = best != 0;
+        for (int repeat = 1; deterministic && repeat < GOLDEN_REPEATS; repeat++)
+        {
+            unsigned long long elapsed = RenderCase(c, &input, &pass);
+            deterministic = elapsed != 0 && memcmp(output.samples, pass.samples, (size_t)frames * c->info.channels * sizeof(float)) == 0;
+            if (elapsed && elapsed < best)
+                best = elapsed;
+        }
+        if (best == 0)
+        {
+            fprintf(stderr, "%s: render failed\n", c->info.name);
+            return 1;
+        }
+        if (!kernelname)
+            kernelname = KernelsName(kernels.level);
+
+        c->hash = Hash(&output);
+        c->ns_per_sample = (double)best / ((double)frames * c->info.channels);
+
+        char path[1024];
+        int dry = DryBlocks(&input, &output);
+        bool mismatch = !deterministic || dry > 0;
+        bool regressed = false;
+        double diff = 0.0;
+
+        if (recorddir)
+        {
+            CasePath(path, sizeof(path), recorddir, c);
+            if (Host_SaveWav(path, &output) != FMOD_OK)
+            {
+                fprintf(stderr, "could not write %s\n", path);
+                return 1;
+            }
+            fprintf(index, "{\"name\": \"%s\", \"channels\": %d, \"lose_type\": %d, \"filter_type\": %d, \"flags\": %d, \"frames\": %u, \"hash\": \"%016llx\", \"ns_per_sample\": %.4f, \"kernels\": \"%s\"}%s\n",
+                c->info.name, c->info.channels, c->info.lose_type, c->info.filter_type, c->flags, frames, c->hash, c->ns_per_sample, kernelname, i + 1 < count ? "," : "");
+        }
+        else if (!c->found)
+            mismatch = true;
+        else
+        {
+            if (c->hash != c->ref_hash)
+            {
+                Host_Wav reference;
+                CasePath(path, sizeof(path), checkdir, c);
+                diff = -1.0;
+                if (Host_LoadWav(path, &reference) == FMOD_OK)
+                {
+                    diff = Compare(&output, &reference);
+                    Host_FreeWav(&reference);
+                }
+
+                // Scalar against scalar is the reference path and has to match bit for bit
+                bool exact = strcmp(kernelname, "scalar") == 0 && strcmp(c->ref_kernels, "scalar") == 0;
+                mismatch = mismatch || exact || !(diff >= 0.0 && diff <= tolerance);
+            }
+
+            regressed = perf && c->ref_ns_per_sample > 0 && c->ns_per_sample > c->ref_ns_per_sample * (1.0 + threshold / 100.0);
+        }
+
+        mismatches += mismatch ? 1 : 0;
+        regressions += regressed ? 1 : 0;
+
+        if (recorddir)
+            fprintf(stderr, "%-40s %016llx %8.3f ns/sample%s\n", c->info.name, c->hash, c->ns_per_sample, dry ? " DRY" : "");
+        else
+        {
+            const char *verdict = !deterministic ? "NONDETERMINISTIC" : dry ? "DRY" : !c->found ? "NO REFERENCE" : mismatch ? "DIFFERS" : regressed ? "SLOWER" : "ok";
+            fprintf(stderr, "%-40s %-16s max diff %-10.3g %8.3f ns/sample (was %.3f)\n", c->info.name, verdict, diff, c->ns_per_sample, c->ref_ns_per_sample);
+        }
+
+        Host_FreeWav(&input);
+        Host_FreeWav(&output);
+        Host_FreeWav(&pass);
+    }
+
+    if (index)
+    {
+        fprintf(index, "],\n\"kernels\": \"%s\"\n}\n", kernelname ? kernelname : "");
+        fclose(index);
+        return mismatches ? 2 : 0;
+    }
+
+    fprintf(stderr, "%d case(s) on %s kernels: %d differ, %d slower by more than %.1f%%\n", count, kernelname ? kernelname : "no", mismatches, regressions, threshold);
+    return mismatches ? 2 : regressions ? 3 : 0;
+}
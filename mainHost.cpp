@@ -0,0 +1,139 @@
+/*==============================================================================
+intRference headless host
+
+Runs the plugin outside FMOD on synthetic or WAV input and reports its cost.
+
+    intrference_host [-i in.wav] [-o out.wav] [-b blocksize] [-r rate] [-c channels]
+                     [-s seconds] [-l loops] [-g budget %] [-p "Noise Volume=50"] [-p 4=1] ...
+
+Parameters are given by name or index, the host converts to the declared type.
+-g turns the real time guard on: every block has to finish within budget percent
+of its playing time, and with host_guard.cpp linked in, allocations, locks and
+I/O inside the callbacks are reported. The exit code is 2 when the guard fired.
+==============================================================================*/
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "host.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void Usage()
+{
+    fprintf(stderr, "usage: intrference_host [-i in.wav] [-o out.wav] [-b blocksize] [-r rate] [-c channels] [-s seconds] [-l loops] [-g budget%%] [-p name=value]...\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    const char  *inpath = 0;
+    const char  *outpath = 0;
+    unsigned int blocksize = 1024;
+    int          samplerate = 48000;
+    int          channels = 2;
+    float        seconds = 10.0f;
+    int          loops = 1;
+    float        budget = 0.0f;
+    const char  *params[64];
+    int          numparams = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc || argv[i][0] != '-')
+            Usage();
+
+        const char *value = argv[++i];
+        switch (argv[i - 1][1])
+        {
+            case 'i':   inpath = value;                             break;
+            case 'o':   outpath = value;                            break;
+            case 'b':   blocksize = (unsigned int)atoi(value);      break;
+            case 'r':   samplerate = atoi(value);                   break;
+            case 'c':   channels = atoi(value);                     break;
+            case 's':   seconds = (float)atof(value);               break;
+            case 'l':   loops = atoi(value);                        break;
+            case 'g':   budget = (float)atof(value);                break;
+            case 'p':   if (numparams < 64) params[numparams++] = value;   break;
+            default:    Usage();
+        }
+    }
+
+    Host_Wav input;
+    if (inpath)
+    {
+        if (Host_LoadWav(inpath, &input) != FMOD_OK)
+        {
+            fprintf(stderr, "could not load %s\n", inpath);
+            return 1;
+        }
+        channels = input.channels;
+        samplerate = input.samplerate;
+    }
+    else
+    {
+        if (Host_AllocWav(&input, (unsigned int)(seconds * samplerate), channels, samplerate) != FMOD_OK)
+            return 1;
+        Host_GenerateVoice(&input, 1);
+    }
+
+    Host_Wav output;
+    if (Host_AllocWav(&output, input.frames, channels, samplerate) != FMOD_OK)
+        return 1;
+
+    Host_Instance host;
+    if (Host_Create(&host, blocksize, samplerate, channels) != FMOD_OK)
+    {
+        fprintf(stderr, "plugin create failed\n");
+        return 1;
+    }
+
+    for (int i = 0; i < numparams; i++)
+    {
+        if (Host_ApplyParameter(&host, params[i]) != FMOD_OK)
+            fprintf(stderr, "ignoring parameter '%s'\n", params[i]);
+    }
+
+    Host_GuardEnable(budget / 100.0);
+
+    unsigned long long start = Host_Clock();
+    for (int loop = 0; loop < loops; loop++)
+    {
+        if (Host_Process(&host, input.samples, output.samples, input.frames) != FMOD_OK)
+        {
+            fprintf(stderr, "plugin read failed\n");
+            return 1;
+        }
+    }
+    unsigned long long elapsed = Host_Clock() - start;
+
+    Host_GuardStats guard;
+    Host_GuardRead(&guard);
+    Host_GuardEnable(0.0);
+
+    double samples = (double)input.frames * channels * loops;
+    double audioseconds = (double)input.frames * loops / samplerate;
+    double cpuseconds = elapsed / 1e9;
+
+    printf("%u frames x %d channels x %d loops, block %u @ %d Hz\n", input.frames, channels, loops, blocksize, samplerate);
+    printf("%.3f ms total, %.2f ns/sample, %.0fx realtime (voices per core)\n", elapsed / 1e6, elapsed / samples, cpuseconds > 0 ? audioseconds / cpuseconds : 0.0);
+    printf("%llu of %llu blocks skipped as idle\n", host.skipped, (host.clock + blocksize - 1) / blocksize);
+    if (budget > 0)
+    {
+        printf("rt guard: worst block %.1f us, %.1f%% of its playing time, %llu of %llu over the %g%% budget\n",
+            guard.worst_ns / 1e3, guard.worst_share * 100.0, guard.over_budget, guard.calls, budget);
+        if (guard.hooked)
+            printf("rt guard: %llu real time unsafe call(s) inside callbacks\n", guard.violations);
+        else
+            printf("rt guard: host_guard.cpp not linked in, allocations and locks unchecked\n");
+    }
+
+    if (outpath && Host_SaveWav(outpath, &output) != FMOD_OK)
+        fprintf(stderr, "could not write %s\n", outpath);
+
+    Host_Release(&host);
+    Host_FreeWav(&input);
+    Host_FreeWav(&output);
+
+    return guard.violations || guard.over_budget ? 2 : 0;
+}
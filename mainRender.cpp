@@ -0,0 +1,399 @@
+/*==============================================================================
+intRference offline renderer
+
+Processes WAV files through the plugin as fast as the CPU allows, one plugin
+instance per piece of work and the work spread over a pool of worker threads.
+Inputs are memory mapped and decoded a chunk at a time, outputs are written as
+32 bit float through a large buffer, so memory stays flat whatever the length.
+
+    intrference_render [-j workers] [-b blocksize] [-d outdir] [-x suffix]
+                       [-s seed] [-k chunk seconds] [-w warmup ms]
+                       [-p "Noise Volume=50"] [-p 4=1] ... in.wav ...
+
+Each in.wav is written to outdir (default: next to the input) as
+in<suffix>.wav, suffix defaults to _intrf. Every instance gets the same Seed
+(default 1), so a render is reproducible.
+
+With -k files longer than the chunk length are cut into chunks rendered in
+parallel. The plugin's random draws depend only on the seed and the frame, so
+each chunk's instance starts warmup ms early to settle its filter and packet
+state and then continues exactly where a single render would be. The end of
+every warm up is compared against the chunk before; a file with a seam that
+does not match bit for bit is rendered again in one piece.
+
+The exit code is 1 when any file failed. Build:
+    g++ -O2 -pthread -I$FMOD_INC intrference.cpp intrference_dsp.cpp intrference_pool.cpp intrference_batch.cpp intrference_timing.cpp host.cpp mainRender.cpp -o intrference_render
+==============================================================================*/
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "host.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+    #define RENDER_FSEEK _fseeki64
+#else
+    #define RENDER_FSEEK fseeko
+#endif
+
+#define RENDER_MAX_PARAMS   64
+#define RENDER_PIECE_FRAMES 65536           // Decoded per Host_Process call, rounded down to whole blocks
+#define RENDER_OUT_BUFFER   (4 << 20)
+#define RENDER_SEAM_FRAMES  4096            // Compared at every seam
+#define RENDER_WAV_HEADER   44
+
+typedef struct
+{
+    unsigned int blocksize;
+    const char  *outdir;
+    const char  *suffix;
+    int          seed;
+    float        chunk_seconds;              // 0 renders every file in one piece
+    float        warmup_ms;
+    const char  *params[RENDER_MAX_PARAMS];
+    int          numparams;
+} Render_Options;
+
+typedef struct
+{
+    const char  *inpath;
+    char         outpath[1024];
+    Host_Mapping mapping;
+    Host_WavView view;
+    bool         ok;
+    bool         created;                    // Output file is ours to remove on failure
+    bool         rerendered;                 // A seam did not match
+} Render_File;
+
+typedef struct
+{
+    Render_File *file;
+    unsigned int first;
+    unsigned int frames;
+    unsigned int warmup;                     // Frames rendered before first and thrown away
+    bool         ok;
+    double       seconds;                    // Wall time spent on the chunk
+    std::vector<float> head;                 // Last RENDER_SEAM_FRAMES of the warm up
+    std::vector<float> tail;                 // Last RENDER_SEAM_FRAMES of the chunk
+} Render_Chunk;
+
+static void Usage()
+{
+    fprintf(stderr, "usage: intrference_render [-j workers] [-b blocksize] [-d outdir] [-x suffix] [-s seed] [-k chunk seconds] [-w warmup ms] [-p name=value]... in.wav...\n");
+    exit(1);
+}
+
+static void OutputPath(const Render_Options *options, Render_File *file)
+{
+    const char *path = file->inpath;
+    const char *base = path;
+    for (const char *p = path; *p; p++)
+    {
+        if (*p == '/' || *p == '\\')
+            base = p + 1;
+    }
+
+    const char *dot = strrchr(base, '.');
+    int stem = dot ? (int)(dot - base) : (int)strlen(base);
+
+    if (options->outdir)
+        snprintf(file->outpath, sizeof(file->outpath), "%s/%.*s%s.wav", options->outdir, stem, base, options->suffix);
+    else
+        snprintf(file->outpath, sizeof(file->outpath), "%.*s%.*s%s.wav", (int)(base - path), path, stem, base, options->suffix);
+}
+
+/*
+    Maps and checks the input and writes the output header, the chunks then fill in the samples in any order.
+*/
+static bool OpenFile(Render_File *file)
+{
+    if (Host_MapFile(file->inpath, &file->mapping) != FMOD_OK)
+    {
+        fprintf(stderr, "%s: could not open\n", file->inpath);
+        return false;
+    }
+    if (Host_ParseWav(file->mapping.data, file->mapping.size, &file->view) != FMOD_OK)
+    {
+        fprintf(stderr, "%s: unsupported format\n", file->inpath);
+        return false;
+    }
+
+    FILE *out = fopen(file->outpath, "wb");
+    if (!out)
+    {
+        fprintf(stderr, "%s: could not create\n", file->outpath);
+        return false;
+    }
+    file->created = true;
+    bool ok = Host_WriteWavHeader(out, file->view.frames, file->view.channels, file->view.samplerate) == FMOD_OK;
+    return fclose(out) == 0 && ok;
+}
+
+//Runs frames from first through the plugin, writes them when out is set and keeps the last ones in keep
+static bool RenderRange(Host_Instance *host, const Host_WavView *view, unsigned int first, unsigned int frames, unsigned int piece,
+                        float *input, float *output, FILE *out, std::vector<float> *keep)
+{
+    unsigned int keepframes = (unsigned int)(keep->size() / view->channels);
+    unsigned int keepfirst = first + frames - keepframes;
+
+    bool ok = true;
+    for (unsigned int done = 0; ok && done < frames; done += piece)
+    {
+        unsigned int at = first + done;
+        unsigned int length = frames - done < piece ? frames - done : piece;
+        size_t count = (size_t)length * view->channels;
+
+        Host_DecodeWav(view, at, length, input);
+        ok = Host_Process(host, input, output, length) == FMOD_OK;
+        if (ok && out)
+            ok = fwrite(output, sizeof(float), count, out) == count;     // Little endian hosts only
+
+        unsigned int from = at > keepfirst ? at : keepfirst;
+        if (ok && from < at + length)
+            memcpy(&(*keep)[(size_t)(from - keepfirst) * view->channels], output + (size_t)(from - at) * view->channels, (size_t)(at + length - from) * view->channels * sizeof(float));
+    }
+
+    return ok;
+}
+
+static bool RenderChunk(const Render_Options *options, Render_Chunk *chunk)
+{
+    const Host_WavView *view = &chunk->file->view;
+
+    Host_Instance host;
+    if (Host_Create(&host, options->blocksize, view->samplerate, view->channels) != FMOD_OK)
+    {
+        fprintf(stderr, "%s: could not create the plugin\n", chunk->file->inpath);
+        return false;
+    }
+
+    bool ok = Host_SetParameterInt(&host, Host_FindParameter(&host, "Seed"), options->seed) == FMOD_OK;
+    for (int i = 0; i < options->numparams && ok; i++)
+    {
+        ok = Host_ApplyParameter(&host, options->params[i]) == FMOD_OK;
+        if (!ok)
+            fprintf(stderr, "bad parameter %s\n", options->params[i]);
+    }
+
+    FILE *out = ok ? fopen(chunk->file->outpath, "r+b") : 0;
+    ok = ok && out && RENDER_FSEEK(out, RENDER_WAV_HEADER + (long long)chunk->first * view->channels * sizeof(float), SEEK_SET) == 0;
+
+    unsigned int piece = RENDER_PIECE_FRAMES - RENDER_PIECE_FRAMES % options->blocksize;
+    if (piece == 0)
+        piece = options->blocksize;
+
+    std::vector<char> outbuffer;
+    std::vector<float> input, output;
+    if (ok)
+    {
+        outbuffer.resize(RENDER_OUT_BUFFER);
+        setvbuf(out, &outbuffer[0], _IOFBF, outbuffer.size());
+        input.resize((size_t)piece * view->channels);
+        output.resize((size_t)piece * view->channels);
+
+        unsigned int seam = RENDER_SEAM_FRAMES;
+        chunk->head.assign((size_t)(chunk->warmup < seam ? chunk->warmup : seam) * view->channels, 0.0f);
+        chunk->tail.assign((size_t)(chunk->frames < seam ? chunk->frames : seam) * view->channels, 0.0f);
+
+        // Whole blocks up to the chunk, so only the file's last block is zero padded, same as rendering it in one go
+        Host_Seek(&host, chunk->first - chunk->warmup);
+        ok = RenderRange(&host, view, chunk->first - chunk->warmup, chunk->warmup, piece, &input[0], &output[0], 0, &chunk->head);
+        ok = ok && RenderRange(&host, view, chunk->first, chunk->frames, piece, &input[0], &output[0], out, &chunk->tail);
+    }
+
+    if (out)
+        ok = fclose(out) == 0 && ok;
+    else if (ok)
+        fprintf(stderr, "%s: could not write\n", chunk->file->outpath);
+
+    Host_Release(&host);
+    return ok;
+}
+
+static void Worker(const Render_Options *options, Render_Chunk *chunks, int count, std::atomic<int> *next)
+{
+    for (;;)
+    {
+        int i = next->fetch_add(1);
+        if (i >= count)
+            return;
+
+        unsigned long long start = Host_Clock();
+        chunks[i].ok = RenderChunk(options, &chunks[i]);
+        chunks[i].seconds = (Host_Clock() - start) / 1e9;
+    }
+}
+
+static void RenderAll(const Render_Options *options, std::vector<Render_Chunk> &chunks, int workers)
+{
+    int count = (int)chunks.size();
+    if (count == 0)
+        return;
+    if (workers > count)
+        workers = count;
+
+    std::atomic<int> next(0);
+    std::vector<std::thread> threads;
+    for (int i = 1; i < workers; i++)
+        threads.push_back(std::thread(Worker, options, &chunks[0], count, &next));
+    Worker(options, &chunks[0], count, &next);
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+}
+
+static void AddChunks(const Render_Options *options, Render_File *file, bool split, std::vector<Render_Chunk> &chunks)
+{
+    unsigned int frames = file->view.frames;
+    unsigned int length = frames;
+    unsigned int warmup = 0;
+    if (split && options->chunk_seconds > 0)
+    {
+        double blocks = (double)options->chunk_seconds * file->view.samplerate / options->blocksize;
+        if (blocks < 1.0)
+            blocks = 1.0;
+        if (blocks * options->blocksize < frames)
+            length = (unsigned int)blocks * options->blocksize;
+        warmup = (unsigned int)((double)options->warmup_ms * file->view.samplerate / 1000.0 / options->blocksize + 0.999) * options->blocksize;
+    }
+
+    unsigned int first = 0;
+    do
+    {
+        Render_Chunk chunk;
+        chunk.file = file;
+        chunk.first = first;
+        chunk.frames = frames - first < length ? frames - first : length;
+        chunk.warmup = first < warmup ? first : warmup;
+        chunk.ok = false;
+        chunk.seconds = 0.0;
+        chunks.push_back(chunk);
+        first += chunk.frames;
+    } while (first < frames);
+}
+
+int main(int argc, char **argv)
+{
+    Render_Options options;
+    memset(&options, 0, sizeof(options));
+    options.blocksize = 1024;
+    options.suffix = "_intrf";
+    options.seed = 1;
+    options.warmup_ms = 1000.0f;
+
+    int workers = (int)std::thread::hardware_concurrency();
+    std::vector<Render_File> files;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (argv[i][0] != '-')
+        {
+            Render_File file;
+            memset(&file, 0, sizeof(file));
+            file.inpath = argv[i];
+            files.push_back(file);
+            continue;
+        }
+        if (i + 1 >= argc)
+            Usage();
+
+        const char *value = argv[++i];
+        switch (argv[i - 1][1])
+        {
+            case 'j':   workers = atoi(value);                              break;
+            case 'b':   options.blocksize = (unsigned int)atoi(value);      break;
+            case 'd':   options.outdir = value;                             break;
+            case 'x':   options.suffix = value;                             break;
+            case 's':   options.seed = atoi(value);                         break;
+            case 'k':   options.chunk_seconds = (float)atof(value);         break;
+            case 'w':   options.warmup_ms = (float)atof(value);             break;
+            case 'p':   if (options.numparams < RENDER_MAX_PARAMS) options.params[options.numparams++] = value;     break;
+            default:    Usage();
+        }
+    }
+
+    if (files.empty() || options.blocksize == 0)
+        Usage();
+    if (workers < 1)
+        workers = 1;
+
+    unsigned long long start = Host_Clock();
+
+    std::vector<Render_Chunk> chunks;
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        OutputPath(&options, &files[i]);
+        files[i].ok = OpenFile(&files[i]);
+        if (files[i].ok)
+            AddChunks(&options, &files[i], true, chunks);
+    }
+
+    RenderAll(&options, chunks, workers);
+
+    // A chunk's warm up has to end on exactly what the chunk before it wrote, or its state had not settled
+    int seams = 0;
+    std::vector<Render_Chunk> again;
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        Render_File *file = chunks[i].file;
+        file->ok = file->ok && chunks[i].ok;
+        if (i == 0 || chunks[i - 1].file != file || !chunks[i].ok || !chunks[i - 1].ok)
+            continue;
+
+        const std::vector<float> &head = chunks[i].head;
+        const std::vector<float> &tail = chunks[i - 1].tail;
+        size_t n = head.size() < tail.size() ? head.size() : tail.size();
+        seams++;
+        if (n == 0 || memcmp(&head[head.size() - n], &tail[tail.size() - n], n * sizeof(float)) != 0)
+            file->rerendered = true;
+    }
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        if (files[i].ok && files[i].rerendered)
+            AddChunks(&options, &files[i], false, again);
+    }
+
+    RenderAll(&options, again, workers);
+    for (size_t i = 0; i < again.size(); i++)
+        again[i].file->ok = again[i].ok;
+
+    double wall = (Host_Clock() - start) / 1e9;
+
+    int failed = 0, rerendered = 0;
+    double audio = 0.0;
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        Render_File *file = &files[i];
+        Host_UnmapFile(&file->mapping);
+        if (!file->ok)
+        {
+            failed++;
+            if (file->created)
+                remove(file->outpath);
+            continue;
+        }
+
+        double seconds = 0.0;
+        for (size_t c = 0; c < chunks.size(); c++)
+            seconds += chunks[c].file == file ? chunks[c].seconds : 0.0;
+        for (size_t c = 0; c < again.size(); c++)
+            seconds += again[c].file == file ? again[c].seconds : 0.0;
+
+        double length = file->view.samplerate > 0 ? (double)file->view.frames / file->view.samplerate : 0.0;
+        audio += length;
+        rerendered += file->rerendered ? 1 : 0;
+        printf("%-40s %9.2f s audio %8.3f s %8.1fx realtime%s\n", file->outpath, length, seconds, seconds > 0 ? length / seconds : 0.0, file->rerendered ? "  (rendered again)" : "");
+    }
+
+    printf("files:     %d rendered, %d failed, %d workers\n", (int)files.size() - failed, failed, workers);
+    printf("chunks:    %d, %d seams, %d file(s) rendered again\n", (int)chunks.size(), seams, rerendered);
+    printf("audio:     %.2f s\n", audio);
+    printf("wall:      %.3f s\n", wall);
+    printf("speed:     %.1fx realtime\n", wall > 0 ? audio / wall : 0.0);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,322 @@
+/*==============================================================================
+intRference multithreaded stress test
+
+Creates hundreds of plugin instances through the headless host (concurrently,
+so the pool and the shared tables get created under contention too), then
+processes them on 1, 2, 4 ... N threads while another thread keeps setting
+random values through every set callback, reading back the data parameters
+and resetting instances now and then.
+Each instance only ever runs on one thread at a time, like a DSP in an FMOD
+mixer. Reports realtime voices per thread count and how close the scaling
+comes to linear.
+
+    intrference_stress [-n instances] [-t threads] [-b blocksize]
+                       [-c channels] [-s seconds] [-e min efficiency %]
+                       [-nohammer]
+
+The exit code is 1 when a call failed or an output went non finite, 2 when
+the efficiency at the highest thread count is below -e. Build, and the same
+with ThreadSanitizer to look for data races:
+    g++ -O2 -pthread -I$FMOD_INC intrference.cpp intrference_dsp.cpp intrference_pool.cpp intrference_batch.cpp intrference_timing.cpp host.cpp mainStress.cpp -o intrference_stress
+    g++ -O1 -g -fsanitize=thread -pthread -I$FMOD_INC ... mainStress.cpp -o intrference_stress_tsan
+==============================================================================*/
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "host.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#define STRESS_SAMPLERATE   48000
+#define STRESS_CHECK_EVERY  16          // Blocks between scans of the output for NaN and infinity
+#define STRESS_RESET_EVERY  64          // Hammer calls per reset, on average
+
+typedef struct
+{
+    int          instances;
+    int          threads;
+    unsigned int blocksize;
+    int          channels;
+    float        seconds;
+    double       min_efficiency;
+    bool         hammer;
+} Stress_Options;
+
+typedef struct
+{
+    Host_Instance *hosts;
+    int          count;
+    const Stress_Options *options;
+    std::atomic<bool> stop;
+    std::atomic<int> failures;          // Calls that did not return FMOD_OK
+    std::atomic<int> nonfinite;         // Output blocks with NaN or infinity
+    std::atomic<unsigned long long> sets;
+} Stress_Shared;
+
+static void Usage()
+{
+    fprintf(stderr, "usage: intrference_stress [-n instances] [-t threads] [-b blocksize] [-c channels] [-s seconds] [-e min efficiency %%] [-nohammer]\n");
+    exit(1);
+}
+
+//Every instance gets its own mix of modes, so the threads run the whole plugin and not one path of it
+static FMOD_RESULT Configure(Host_Instance *host, int index)
+{
+    FMOD_RESULT result = Host_SetParameterInt(host, Host_FindParameter(host, "Seed"), index + 1);
+    if (result == FMOD_OK)
+        result = Host_SetParameter(host, Host_FindParameter(host, "Voice Shatter"), 50.0f);
+    if (result == FMOD_OK)
+        result = Host_SetParameter(host, Host_FindParameter(host, "Noise Volume"), 50.0f);
+    if (result == FMOD_OK)
+        result = Host_SetParameter(host, Host_FindParameter(host, "Lose Rate"), 40.0f);
+    if (result == FMOD_OK)
+        result = Host_SetParameter(host, Host_FindParameter(host, "Lose Type"), (float)(index % 4));
+    if (result == FMOD_OK)
+        result = Host_SetParameter(host, Host_FindParameter(host, "Lose Samples"), index % 5 != 4 ? 1.0f : 0.0f);
+    if (result == FMOD_OK)
+        result = Host_SetParameter(host, Host_FindParameter(host, "Filter Type"), (float)(index % 3));
+    if (result == FMOD_OK)
+        result = Host_SetParameter(host, Host_FindParameter(host, "Filter Enabled"), index % 7 != 6 ? 1.0f : 0.0f);
+    if (result == FMOD_OK)
+        result = Host_SetParameter(host, Host_FindParameter(host, "Noise Bank"), index % 2 ? 1.0f : 0.0f);
+    return result;
+}
+
+static void CreateWorker(Stress_Shared *shared, int first, int step)
+{
+    const Stress_Options *options = shared->options;
+    for (int i = first; i < shared->count; i += step)
+    {
+        Host_Instance *host = &shared->hosts[i];
+        if (Host_Create(host, options->blocksize, STRESS_SAMPLERATE, options->channels) != FMOD_OK || Configure(host, i) != FMOD_OK)
+            shared->failures++;
+    }
+}
+
+static bool IsFinite(const float *buffer, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!(fabsf(buffer[i]) <= 3.0e38f))
+            return false;
+    }
+    return true;
+}
+
+//Instances first, first + step, ... in turn, one block each, until told to stop
+static void MixWorker(Stress_Shared *shared, int first, int step, unsigned long long *blocks)
+{
+    const Stress_Options *options = shared->options;
+
+    Host_Wav input;
+    std::vector<float> output((size_t)options->blocksize * options->channels);
+    if (Host_AllocWav(&input, options->blocksize * 64, options->channels, STRESS_SAMPLERATE) != FMOD_OK)
+    {
+        shared->failures++;
+        return;
+    }
+    Host_GenerateVoice(&input, first + 1);
+
+    unsigned long long done = 0;
+    while (!shared->stop.load(std::memory_order_relaxed))
+    {
+        for (int i = first; i < shared->count; i += step)
+        {
+            float *in = input.samples + (size_t)(done % 64) * options->blocksize * options->channels;
+            if (Host_Read(&shared->hosts[i], in, &output[0], options->blocksize) != FMOD_OK)
+                shared->failures++;
+            if (done % STRESS_CHECK_EVERY == 0 && !IsFinite(&output[0], output.size()))
+                shared->nonfinite++;
+            done++;
+        }
+    }
+
+    Host_FreeWav(&input);
+    *blocks = done;
+}
+
+/*
+    Stands in for the game thread: random values through every settable parameter of random instances, the data
+    parameters read back through the returned pointer, and a reset now and then. Only one setter per instance at a
+    time, as FMOD guarantees.
+*/
+static void HammerWorker(Stress_Shared *shared)
+{
+    unsigned int state = 12345u;
+    unsigned long long sets = 0;
+    volatile unsigned int sink = 0;
+
+    while (!shared->stop.load(std::memory_order_relaxed))
+    {
+        state = state * 747796405u + 2891336453u;
+        Host_Instance *host = &shared->hosts[(state >> 8) % shared->count];
+        FMOD_DSP_DESCRIPTION *desc = host->desc;
+
+        state = state * 747796405u + 2891336453u;
+        int index = (int)((state >> 8) % desc->numparameters);
+        FMOD_DSP_PARAMETER_DESC *param = desc->paramdesc[index];
+
+        state = state * 747796405u + 2891336453u;
+        float unit = (state >> 8) * (1.0f / 16777216.0f);
+
+        FMOD_RESULT result = FMOD_OK;
+        if ((state >> 8) % STRESS_RESET_EVERY == 0)
+        {
+            // Not Host_Reset, its clock belongs to the mixing thread
+            result = desc->reset(&host->state);
+        }
+        else if (param->type == FMOD_DSP_PARAMETER_TYPE_FLOAT)
+            result = Host_SetParameterFloat(host, index, param->floatdesc.min + unit * (param->floatdesc.max - param->floatdesc.min));
+        else if (param->type == FMOD_DSP_PARAMETER_TYPE_INT)
+            result = Host_SetParameterInt(host, index, param->intdesc.min + (int)(unit * ((double)param->intdesc.max - param->intdesc.min + 1)));
+        else if (param->type == FMOD_DSP_PARAMETER_TYPE_BOOL)
+            result = Host_SetParameterBool(host, index, unit < 0.5f);
+        else
+        {
+            void *data;
+            unsigned int length;
+            result = Host_GetParameterData(host, index, &data, &length);
+
+            // Every byte the mixer may be publishing at the same time
+            unsigned int sum = 0;
+            for (unsigned int i = 0; result == FMOD_OK && i < length; i++)
+                sum += ((const unsigned char *)data)[i];
+            sink = sink + sum;
+        }
+
+        if (result != FMOD_OK)
+            shared->failures++;
+        sets++;
+    }
+
+    shared->sets.fetch_add(sets);
+}
+
+//Realtime voices the threads sustained together
+static double Measure(Stress_Shared *shared, int threads, unsigned long long *sets)
+{
+    const Stress_Options *options = shared->options;
+    std::vector<unsigned long long> blocks(threads, 0);
+    std::vector<std::thread> workers;
+
+    shared->stop.store(false);
+    shared->sets.store(0);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int t = 0; t < threads; t++)
+        workers.push_back(std::thread(MixWorker, shared, t, threads, &blocks[t]));
+    if (options->hammer)
+        workers.push_back(std::thread(HammerWorker, shared));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds((int)(options->seconds * 1000)));
+    shared->stop.store(true);
+    for (size_t t = 0; t < workers.size(); t++)
+        workers[t].join();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    unsigned long long total = 0;
+    for (int t = 0; t < threads; t++)
+        total += blocks[t];
+
+    *sets = shared->sets.load();
+    return (double)total * options->blocksize / STRESS_SAMPLERATE / elapsed;
+}
+
+int main(int argc, char **argv)
+{
+    Stress_Options options;
+    options.instances = 256;
+    options.threads = (int)std::thread::hardware_concurrency();
+    options.blocksize = 1024;
+    options.channels = 2;
+    options.seconds = 1.0f;
+    options.min_efficiency = 0.0;
+    options.hammer = true;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-nohammer") == 0)
+        {
+            options.hammer = false;
+            continue;
+        }
+        if (i + 1 >= argc || argv[i][0] != '-')
+            Usage();
+
+        const char *value = argv[++i];
+        switch (argv[i - 1][1])
+        {
+            case 'n':   options.instances = atoi(value);                    break;
+            case 't':   options.threads = atoi(value);                      break;
+            case 'b':   options.blocksize = (unsigned int)atoi(value);      break;
+            case 'c':   options.channels = atoi(value);                     break;
+            case 's':   options.seconds = (float)atof(value);               break;
+            case 'e':   options.min_efficiency = atof(value);               break;
+            default:    Usage();
+        }
+    }
+    if (options.instances < 1 || options.threads < 1 || options.blocksize == 0 || options.channels < 1)
+        Usage();
+
+    std::vector<Host_Instance> hosts(options.instances);
+    Stress_Shared shared;
+    shared.hosts = &hosts[0];
+    shared.count = options.instances;
+    shared.options = &options;
+    shared.failures.store(0);
+    shared.nonfinite.store(0);
+
+    std::vector<std::thread> creators;
+    for (int t = 0; t < options.threads; t++)
+        creators.push_back(std::thread(CreateWorker, &shared, t, options.threads));
+    for (int t = 0; t < options.threads; t++)
+        creators[t].join();
+    if (shared.failures.load())
+    {
+        fprintf(stderr, "%d instance(s) failed to create\n", shared.failures.load());
+        return 1;
+    }
+
+    printf("%d instances, %u frames x %d channels per block, %s\n", options.instances, options.blocksize, options.channels, options.hammer ? "parameters hammered" : "no parameter changes");
+    printf("threads   voices  ns/block   scaling  efficiency   sets/s\n");
+
+    double single = 0.0, efficiency = 0.0;
+    for (int threads = 1; ; threads = threads * 2 < options.threads ? threads * 2 : options.threads)
+    {
+        unsigned long long sets = 0;
+        double voices = Measure(&shared, threads, &sets);
+        if (threads == 1)
+            single = voices;
+
+        double scaling = single > 0 ? voices / single : 0.0;
+        efficiency = scaling / threads * 100.0;
+        double nsperblock = voices > 0 ? threads * 1e9 * options.blocksize / STRESS_SAMPLERATE / voices : 0.0;
+        printf("%7d %8.0f %9.0f %8.2fx %10.1f%% %8.0f\n", threads, voices, nsperblock, scaling, efficiency, sets / options.seconds);
+
+        if (threads == options.threads)
+            break;
+    }
+
+    for (int i = 0; i < options.instances; i++)
+        Host_Release(&hosts[i]);
+
+    int failures = shared.failures.load();
+    int nonfinite = shared.nonfinite.load();
+    if (failures || nonfinite)
+    {
+        fprintf(stderr, "%d failed call(s), %d non finite block(s)\n", failures, nonfinite);
+        return 1;
+    }
+    if (efficiency < options.min_efficiency)
+    {
+        fprintf(stderr, "efficiency %.1f%% at %d threads, below %.1f%%\n", efficiency, options.threads, options.min_efficiency);
+        return 2;
+    }
+    return 0;
+}